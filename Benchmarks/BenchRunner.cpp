@@ -0,0 +1,324 @@
+/**
+ * End-to-End Benchmark Runner
+ * Runs the interpreter over a corpus of RPAL programs and reports wall time,
+ * CPU time, machine steps and peak memory for each one. Every program is run
+ * in a fresh child process: a warm-up run first, then the measured runs, from
+ * which the median and 95th percentile wall times are taken. Machine steps come
+ * from the interpreter's own --stats=json report and peak memory from the
+ * child's resource usage. When a <program>.out file sits next to a program its
+ * output is checked against it, so a change that speeds a program up by
+ * breaking it does not go unnoticed.
+ *
+ * Results are written as JSON, one benchmark per line so two result files diff
+ * cleanly. Given a baseline result file, each benchmark is compared with it
+ * and a change is only called out when the medians differ by more than the
+ * noise threshold and a Mann-Whitney U test on the two sample sets agrees.
+ *
+ * Usage: benchrunner [--interpreter=<path>] [--runs=<n>] [--warmup=<n>]
+ *                    [--output=<path>] [--baseline=<path>] <program.rpal>...
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "BenchSupport.h"
+
+using namespace std;
+
+static const double SIGNIFICANCE_LEVEL = 0.05;     // Two-sided p-value below which a change is real
+static const double NOISE_THRESHOLD = 0.02;        // Relative median change always treated as noise
+
+struct RunnerOptions {
+    RunnerOptions() : interpreter("./myrpal"), runs(10), warmup(1) {}
+    string interpreter;
+    int runs;
+    int warmup;
+    string outputFile;
+    string baselineFile;
+    vector<string> programs;
+};
+
+// Aggregated result for one program, also what a baseline file is read back into
+struct BenchmarkResult {
+    BenchmarkResult() : medianMs(0), p95Ms(0), minMs(0), meanMs(0), cpuMs(0),
+            steps(0), peakRssKb(0) {}
+    string name;
+    string status;                  // "ok", "failed" or "wrong output"
+    double medianMs;
+    double p95Ms;
+    double minMs;
+    double meanMs;
+    double cpuMs;
+    unsigned long long steps;
+    long peakRssKb;
+    vector<double> samplesMs;
+};
+
+static string baseName(const string& path) {
+    size_t slash = path.find_last_of('/');
+    string name = slash == string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.rfind(".rpal");
+    return dot == string::npos ? name : name.substr(0, dot);
+}
+
+/**
+ * Runs the interpreter once on a program with stdout redirected to outputPath
+ * and the statistics report written to statsPath
+ */
+static ChildRun runOnce(const RunnerOptions& options, const string& program,
+        const string& outputPath, const string& statsPath) {
+    vector<string> args;
+    args.push_back("--stats=json");
+    args.push_back("--stats-file=" + statsPath);
+    args.push_back(program);
+    return runChild(options.interpreter, args, outputPath);
+}
+
+/**
+ * Nearest-rank percentile of a sorted sample set
+ */
+static double percentile(const vector<double>& sorted, double fraction) {
+    if(sorted.empty())
+        return 0;
+    size_t rank = (size_t)ceil(fraction * sorted.size());
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+static double median(const vector<double>& sorted) {
+    if(sorted.empty())
+        return 0;
+    size_t middle = sorted.size() / 2;
+    return sorted.size() % 2 ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2;
+}
+
+static BenchmarkResult runBenchmark(const RunnerOptions& options, const string& program) {
+    BenchmarkResult result;
+    result.name = baseName(program);
+    result.status = "ok";
+    string outputPath = temporaryFile("rpalbench-out");
+    string statsPath = temporaryFile("rpalbench-stats");
+
+    for(int i = 0; i < options.warmup; i++)
+        runOnce(options, program, outputPath, statsPath);
+
+    double cpuTotal = 0;
+    for(int i = 0; i < options.runs; i++) {
+        ChildRun sample = runOnce(options, program, outputPath, statsPath);
+        if(!sample.ok) {
+            result.status = "failed";
+            break;
+        }
+        result.samplesMs.push_back(sample.wallMs);
+        cpuTotal += sample.cpuMs;
+        result.peakRssKb = max(result.peakRssKb, sample.peakRssKb);
+
+        if(i == 0) {
+            string stats;
+            if(readFile(statsPath, stats))
+                result.steps = jsonCounter(stats, "machine_steps");
+            string expected, actual;
+            string expectedPath = program.substr(0, program.size() - 5) + ".out";
+            if(readFile(expectedPath, expected) && (!readFile(outputPath, actual) || actual != expected)) {
+                result.status = "wrong output";
+                break;
+            }
+        }
+    }
+    unlink(outputPath.c_str());
+    unlink(statsPath.c_str());
+
+    if(result.samplesMs.empty())
+        return result;
+    vector<double> sorted = result.samplesMs;
+    sort(sorted.begin(), sorted.end());
+    result.medianMs = median(sorted);
+    result.p95Ms = percentile(sorted, 0.95);
+    result.minMs = sorted.front();
+    double sum = 0;
+    for(unsigned int i = 0; i < sorted.size(); i++)
+        sum += sorted[i];
+    result.meanMs = sum / sorted.size();
+    result.cpuMs = cpuTotal / sorted.size();
+    return result;
+}
+
+/**
+ * Two-sided Mann-Whitney U test with the normal approximation and midranks
+ * for ties; returns the p-value that both sample sets share a distribution
+ */
+static double mannWhitneyP(const vector<double>& a, const vector<double>& b) {
+    size_t n1 = a.size(), n2 = b.size();
+    if(n1 == 0 || n2 == 0)
+        return 1;
+    vector<pair<double, int> > pooled;
+    for(size_t i = 0; i < n1; i++)
+        pooled.push_back(make_pair(a[i], 0));
+    for(size_t i = 0; i < n2; i++)
+        pooled.push_back(make_pair(b[i], 1));
+    sort(pooled.begin(), pooled.end());
+
+    double rankSumA = 0, tieCorrection = 0;
+    for(size_t i = 0; i < pooled.size();) {
+        size_t j = i;
+        while(j < pooled.size() && pooled[j].first == pooled[i].first)
+            j++;
+        double midrank = (i + 1 + j) / 2.0;
+        for(size_t k = i; k < j; k++)
+            if(pooled[k].second == 0)
+                rankSumA += midrank;
+        double ties = j - i;
+        tieCorrection += ties * ties * ties - ties;
+        i = j;
+    }
+
+    double n = n1 + n2;
+    double u = rankSumA - n1 * (n1 + 1) / 2.0;
+    double meanU = n1 * n2 / 2.0;
+    double varianceU = n1 * n2 / 12.0 * ((n + 1) - tieCorrection / (n * (n - 1)));
+    if(varianceU <= 0)
+        return 1;
+    double z = (fabs(u - meanU) - 0.5) / sqrt(varianceU);
+    return z <= 0 ? 1 : erfc(z / sqrt(2.0));
+}
+
+static void writeResults(ostream& out, const RunnerOptions& options, const vector<BenchmarkResult>& results) {
+    out << fixed << setprecision(3);
+    out << "{\"interpreter\": \"" << options.interpreter << "\", \"runs\": " << options.runs
+        << ", \"benchmarks\": [\n";
+    for(unsigned int i = 0; i < results.size(); i++) {
+        const BenchmarkResult& r = results[i];
+        out << "  {\"name\": \"" << r.name << "\", \"status\": \"" << r.status << "\""
+            << ", \"median_ms\": " << r.medianMs << ", \"p95_ms\": " << r.p95Ms
+            << ", \"min_ms\": " << r.minMs << ", \"mean_ms\": " << r.meanMs
+            << ", \"cpu_ms\": " << r.cpuMs << ", \"steps\": " << r.steps
+            << ", \"peak_rss_kb\": " << r.peakRssKb << ", \"samples_ms\": [";
+        for(unsigned int j = 0; j < r.samplesMs.size(); j++)
+            out << (j ? ", " : "") << r.samplesMs[j];
+        out << "]}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]}\n";
+}
+
+/**
+ * Reads a result file written by writeResults back, keyed by benchmark name
+ */
+static bool readBaseline(const string& path, map<string, BenchmarkResult>& baseline) {
+    ifstream in(path.c_str());
+    if(!in)
+        return false;
+    string line;
+    while(getline(in, line)) {
+        BenchmarkResult result;
+        result.name = jsonString(line, "name");
+        if(result.name.empty())
+            continue;
+        result.status = jsonString(line, "status");
+        result.medianMs = jsonNumber(line, "median_ms");
+        result.steps = jsonCounter(line, "steps");
+        result.peakRssKb = (long)jsonCounter(line, "peak_rss_kb");
+        result.samplesMs = jsonArray(line, "samples_ms");
+        baseline[result.name] = result;
+    }
+    return true;
+}
+
+static string compareWithBaseline(const BenchmarkResult& current, const BenchmarkResult& base) {
+    if(current.status != "ok" || base.status != "ok" || base.medianMs <= 0)
+        return "n/a";
+    double change = (current.medianMs - base.medianMs) / base.medianMs;
+    double p = mannWhitneyP(current.samplesMs, base.samplesMs);
+    ostringstream oss;
+    oss << showpos << fixed << setprecision(1) << change * 100 << "%" << noshowpos;
+    if(fabs(change) > NOISE_THRESHOLD && p < SIGNIFICANCE_LEVEL)
+        oss << (change < 0 ? " faster" : " SLOWER");
+    else
+        oss << " ~";
+    oss << " (p=" << setprecision(3) << p << ")";
+    if(current.steps != base.steps)
+        oss << " steps " << base.steps << "->" << current.steps;
+    return oss.str();
+}
+
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [--interpreter=<path>] [--runs=<n>] [--warmup=<n>]" << endl;
+    cerr << "       [--output=<path>] [--baseline=<path>] <program.rpal>..." << endl;
+}
+
+static bool parseArguments(int argc, char* argv[], RunnerOptions& options) {
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg.compare(0, 14, "--interpreter=") == 0)
+            options.interpreter = arg.substr(14);
+        else if(arg.compare(0, 7, "--runs=") == 0)
+            options.runs = atoi(arg.c_str() + 7);
+        else if(arg.compare(0, 9, "--warmup=") == 0)
+            options.warmup = atoi(arg.c_str() + 9);
+        else if(arg.compare(0, 9, "--output=") == 0)
+            options.outputFile = arg.substr(9);
+        else if(arg.compare(0, 11, "--baseline=") == 0)
+            options.baselineFile = arg.substr(11);
+        else if(arg.size() > 1 && arg[0] == '-') {
+            cerr << "Error: Unknown option '" << arg << "'" << endl;
+            return false;
+        } else
+            options.programs.push_back(arg);
+    }
+    return options.runs > 0 && options.warmup >= 0 && !options.programs.empty();
+}
+
+int main(int argc, char* argv[]) {
+    RunnerOptions options;
+    if(!parseArguments(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    map<string, BenchmarkResult> baseline;
+    if(!options.baselineFile.empty() && !readBaseline(options.baselineFile, baseline)) {
+        cerr << "Error: Could not read baseline '" << options.baselineFile << "'" << endl;
+        return 1;
+    }
+
+    cout << left << setw(16) << "benchmark" << right << setw(12) << "median ms" << setw(12) << "p95 ms"
+         << setw(12) << "cpu ms" << setw(12) << "steps" << setw(10) << "rss kb";
+    if(!baseline.empty())
+        cout << "  vs baseline";
+    cout << endl;
+
+    vector<BenchmarkResult> results;
+    bool allOk = true;
+    for(unsigned int i = 0; i < options.programs.size(); i++) {
+        BenchmarkResult result = runBenchmark(options, options.programs[i]);
+        results.push_back(result);
+        cout << left << setw(16) << result.name << right;
+        if(result.status != "ok") {
+            allOk = false;
+            cout << "  " << result.status << endl;
+            continue;
+        }
+        cout << fixed << setprecision(2) << setw(12) << result.medianMs << setw(12) << result.p95Ms
+             << setw(12) << result.cpuMs << setw(12) << result.steps << setw(10) << result.peakRssKb;
+        map<string, BenchmarkResult>::const_iterator base = baseline.find(result.name);
+        if(base != baseline.end())
+            cout << "  " << compareWithBaseline(result, base->second);
+        cout << endl;
+    }
+
+    if(!options.outputFile.empty()) {
+        ofstream out(options.outputFile.c_str());
+        if(!out) {
+            cerr << "Error: Could not write results to '" << options.outputFile << "'" << endl;
+            return 1;
+        }
+        writeResults(out, options, results);
+    }
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+/**
+ * Benchmark Support Implementation
+ * Child process runs measured with wait4, file helpers and flat JSON lookups.
+ */
+
+#include "BenchSupport.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+ChildRun runChild(const string& program, const vector<string>& args, const string& stdoutPath) {
+    ChildRun run = { false, 0, 0, 0 };
+    vector<char*> argv;
+    argv.push_back(const_cast<char*>(program.c_str()));
+    for(unsigned int i = 0; i < args.size(); i++)
+        argv.push_back(const_cast<char*>(args[i].c_str()));
+    argv.push_back(NULL);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    pid_t pid = fork();
+    if(pid < 0)
+        return run;
+    if(pid == 0) {
+        int out = open(stdoutPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int devNull = open("/dev/null", O_WRONLY);
+        if(out < 0 || devNull < 0)
+            _exit(127);
+        dup2(out, STDOUT_FILENO);
+        dup2(devNull, STDERR_FILENO);
+        execv(program.c_str(), &argv[0]);
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    if(wait4(pid, &status, 0, &usage) < 0)
+        return run;
+    run.wallMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    run.cpuMs = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3
+            + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+    run.peakRssKb = usage.ru_maxrss;
+    run.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return run;
+}
+
+bool readFile(const string& path, string& content) {
+    ifstream in(path.c_str(), ios::in | ios::binary);
+    if(!in)
+        return false;
+    ostringstream oss;
+    oss << in.rdbuf();
+    content = oss.str();
+    return true;
+}
+
+string temporaryFile(const char* pattern) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/%s.XXXXXX", pattern);
+    int fd = mkstemp(path);
+    if(fd < 0)
+        return "";
+    close(fd);
+    return path;
+}
+
+unsigned long long jsonCounter(const string& json, const string& key) {
+    size_t pos = json.find("\"" + key + "\":");
+    if(pos == string::npos)
+        return 0;
+    return strtoull(json.c_str() + pos + key.size() + 3, NULL, 10);
+}
+
+double jsonNumber(const string& json, const string& key) {
+    size_t pos = json.find("\"" + key + "\":");
+    if(pos == string::npos)
+        return 0;
+    return strtod(json.c_str() + pos + key.size() + 3, NULL);
+}
+
+string jsonString(const string& json, const string& key) {
+    size_t pos = json.find("\"" + key + "\": \"");
+    if(pos == string::npos)
+        return "";
+    pos += key.size() + 5;
+    size_t end = json.find('"', pos);
+    return end == string::npos ? "" : json.substr(pos, end - pos);
+}
+
+vector<double> jsonArray(const string& json, const string& key) {
+    vector<double> values;
+    size_t pos = json.find("\"" + key + "\": [");
+    if(pos == string::npos)
+        return values;
+    const char* cursor = json.c_str() + pos + key.size() + 5;
+    while(*cursor != ']' && *cursor != '\0') {
+        char* next = NULL;
+        double value = strtod(cursor, &next);
+        if(next == cursor)
+            break;
+        values.push_back(value);
+        cursor = next;
+        while(*cursor == ',' || *cursor == ' ')
+            cursor++;
+    }
+    return values;
+}
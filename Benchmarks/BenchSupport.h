@@ -0,0 +1,39 @@
+/**
+ * Benchmark Support Header
+ * Helpers shared by the benchmark tools that drive the interpreter as a child
+ * process: running it with its output captured, reading files back, and
+ * picking values out of the flat JSON the interpreter and the tools write.
+ */
+
+#ifndef BENCHSUPPORT_H_
+#define BENCHSUPPORT_H_
+
+#include <string>
+#include <vector>
+
+// Outcome of one child process run
+struct ChildRun {
+    bool ok;                        // Exited normally with status 0
+    double wallMs;
+    double cpuMs;                   // User plus system time
+    long peakRssKb;
+};
+
+/**
+ * Runs program with args, stdout redirected to stdoutPath and stderr discarded
+ */
+ChildRun runChild(const std::string& program, const std::vector<std::string>& args,
+        const std::string& stdoutPath);
+
+bool readFile(const std::string& path, std::string& content);
+std::string temporaryFile(const char* pattern);     // Creates an empty file under /tmp
+
+/**
+ * Flat JSON lookups - the value after the first "key": in json
+ */
+unsigned long long jsonCounter(const std::string& json, const std::string& key);
+double jsonNumber(const std::string& json, const std::string& key);
+std::string jsonString(const std::string& json, const std::string& key);
+std::vector<double> jsonArray(const std::string& json, const std::string& key);
+
+#endif /* BENCHSUPPORT_H_ */
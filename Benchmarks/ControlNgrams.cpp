@@ -0,0 +1,152 @@
+/**
+ * Control Sequence Miner
+ * Finds the control token sequences the CSE machine executes most often,
+ * which is how the superinstruction set in CSEMachine was chosen.
+ *
+ * Each program is run on a machine with superinstructions and uncurrying
+ * off while counting how many times every delta is pushed onto the control
+ * stack. Every window of n consecutive tokens within a delta is then
+ * weighted by that count, so the totals are dynamic frequencies of
+ * sequences a builder pass could fuse.
+ * Windows are listed in delta (pre-order) order; the machine executes them
+ * right to left. Operators are kept apart by symbol.
+ *
+ * Usage: ngrams [--max-n=4] [--top=15] program.rpal...
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Lexer.h"
+#include "Parser.h"
+#include "TreeArena.h"
+#include "Standardizer.h"
+#include "CSEMachine.h"
+#include "BenchSupport.h"
+
+using namespace std;
+
+typedef map<string, unsigned long long> NgramCounts;
+
+class ControlNgrams {
+public:
+    /**
+     * Runs one program and adds its weighted windows of 1 to maxN tokens
+     */
+    static bool mine(const string& path, int maxN, vector<NgramCounts>& counts, unsigned long long& steps) {
+        string source;
+        if(!readFile(path, source)) {
+            cerr << "Error: Could not read '" << path << "'" << endl;
+            return false;
+        }
+        TreeArena arena;
+        Lexer lexer(source);
+        Parser parser(&lexer, &arena);
+        parser.parse();
+        TreeStandardizer standardizer(&arena);
+        TreeNode* root = standardizer.standardizeTree(parser.getTree());
+
+        CSEMachine machine(root, &arena);
+        machine.setSuperinstructions(false);
+        machine.setUncurrying(false);
+        machine.createControlStructures(root);
+        vector<unsigned long long> pushes(machine.code->deltas.size(), 0);
+
+        // The program's own output is not wanted here
+        ostringstream discarded;
+        streambuf* output = cout.rdbuf(discarded.rdbuf());
+        Token envToken("env", machine.envCounter);
+        TokenStack controlStack;
+        TokenStack executionStack;
+        controlStack.push(envToken);
+        Environment primitiveEnv = { -1, 0, 0 };
+        machine.environments.push_back(primitiveEnv);
+        machine.pushDelta(0, controlStack);
+        pushes[0]++;
+        executionStack.push(envToken);
+        while(controlStack.size() != 1) {
+            Token currToken(std::move(controlStack.top()));
+            controlStack.pop();
+            const Token& top = executionStack.top();
+            if(currToken.type == "gamma" && top.type == "lambdaClosure")
+                pushes[top.lambdaNum]++;
+            else if(currToken.type == "beta")
+                pushes[top.value == "true" ? currToken.betaIfDeltaNum : currToken.betaElseDeltaNum]++;
+            machine.processCurrentToken(currToken, controlStack, executionStack);
+            steps++;
+        }
+        cout.rdbuf(output);
+
+        for(unsigned int d = 0; d < machine.code->deltas.size(); d++) {
+            const vector<Token>& delta = machine.code->deltas[d];
+            for(unsigned int i = 0; i < delta.size(); i++) {
+                string window;
+                for(int n = 1; n <= maxN && i + n <= delta.size(); n++) {
+                    window += (n > 1 ? " " : "") + tokenClass(delta[i + n - 1]);
+                    counts[n][window] += pushes[d];
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    static string tokenClass(const Token& token) {
+        if(token.type == Lexer::OPT)
+            return "OPT(" + token.value + ")";
+        if(token.type == Lexer::ID)
+            return "ID";
+        if(token.type == Lexer::INT || token.type == Lexer::STR)
+            return token.type.substr(0, 3);
+        if(token.type == "lambdaClosure")
+            return "lambda";
+        if(token.type == "true" || token.type == "false")
+            return "TRUTH";
+        return token.value.empty() ? token.type : token.value;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    int maxN = 4;
+    int top = 15;
+    vector<string> programs;
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg.compare(0, 8, "--max-n=") == 0)
+            maxN = atoi(arg.c_str() + 8);
+        else if(arg.compare(0, 6, "--top=") == 0)
+            top = atoi(arg.c_str() + 6);
+        else
+            programs.push_back(arg);
+    }
+    if(programs.empty() || maxN < 1 || top < 1) {
+        cerr << "Usage: " << argv[0] << " [--max-n=4] [--top=15] program.rpal..." << endl;
+        return 1;
+    }
+
+    vector<NgramCounts> counts(maxN + 1);
+    unsigned long long steps = 0;
+    for(unsigned int i = 0; i < programs.size(); i++) {
+        if(!ControlNgrams::mine(programs[i], maxN, counts, steps))
+            return 1;
+    }
+
+    cout << "Control sequences over " << programs.size() << " programs, " << steps << " machine steps" << endl;
+    for(int n = 1; n <= maxN; n++) {
+        vector<pair<unsigned long long, string> > rows;
+        for(NgramCounts::const_iterator it = counts[n].begin(); it != counts[n].end(); ++it)
+            rows.push_back(make_pair(it->second, it->first));
+        sort(rows.rbegin(), rows.rend());
+        cout << endl << n << "-grams" << setw(14) << "count" << setw(10) << "% steps" << endl;
+        for(int i = 0; i < top && i < (int)rows.size(); i++) {
+            cout << "  " << left << setw(40) << rows[i].second << right << setw(14) << rows[i].first
+                 << fixed << setprecision(2) << setw(10) << (steps == 0 ? 0.0 : 100.0 * rows[i].first / steps) << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,348 @@
+/**
+ * Component Micro-Benchmarks
+ * Times the interpreter's stages and machine primitives in isolation, so a
+ * regression in one of them shows up even when whole-program numbers hide it.
+ * Covers lexing inputs of growing size, parsing deep and wide expressions,
+ * every standardizer transform, control structure generation, environment
+ * lookup through chains of growing depth, and operator application.
+ *
+ * Each benchmark times a batch of operations with any per-operation setup
+ * (fresh lexers, unstandardized trees, new machines) done outside the timed
+ * region, and reports the best of several batches as nanoseconds per
+ * operation. Global operator new is replaced here to count heap allocations,
+ * reported per operation alongside the time.
+ *
+ * Usage: microbench [filter]    runs the benchmarks whose name contains filter
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Lexer.h"
+#include "Parser.h"
+#include "TreeArena.h"
+#include "Standardizer.h"
+#include "CSEMachine.h"
+
+using namespace std;
+
+static unsigned long long allocationCount = 0;
+
+void* operator new(size_t size) {
+    allocationCount++;
+    void* memory = malloc(size == 0 ? 1 : size);
+    if(memory == NULL)
+        throw bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+typedef chrono::steady_clock Clock;
+
+static const int BATCHES = 5;
+static volatile size_t sink;                // Keeps results alive past the optimizer
+
+/**
+ * Accumulates time and allocations over the timed parts of one batch
+ */
+class BatchTimer {
+public:
+    BatchTimer() : nanos(0), allocations(0), startAllocations(0) {}
+    void start() {
+        startAllocations = allocationCount;
+        startTime = Clock::now();
+    }
+    void stop() {
+        Clock::time_point end = Clock::now();
+        allocations += allocationCount - startAllocations;
+        nanos += chrono::duration<double, nano>(end - startTime).count();
+    }
+    double nanos;
+    unsigned long long allocations;
+private:
+    unsigned long long startAllocations;
+    Clock::time_point startTime;
+};
+
+typedef function<void(int ops, BatchTimer& timer)> BenchmarkBody;
+
+static string nameFilter;
+
+/**
+ * Runs a benchmark body for a number of batches and prints its best batch
+ */
+static void runBenchmark(const string& name, int ops, const BenchmarkBody& body) {
+    if(!nameFilter.empty() && name.find(nameFilter) == string::npos)
+        return;
+    double bestNanos = 0;
+    unsigned long long allocations = 0;
+    for(int batch = 0; batch < BATCHES; batch++) {
+        BatchTimer timer;
+        body(ops, timer);
+        if(batch == 0 || timer.nanos < bestNanos) {
+            bestNanos = timer.nanos;
+            allocations = timer.allocations;
+        }
+    }
+    cout << left << setw(42) << name << right << setw(8) << ops
+         << fixed << setprecision(1) << setw(14) << bestNanos / ops
+         << setw(12) << (double)allocations / ops << endl;
+}
+
+/**
+ * Front-end helpers - parse and optionally standardize a program into an arena
+ */
+static TreeNode* parseProgram(const string& source, TreeArena& arena) {
+    Lexer lexer(source);
+    Parser parser(&lexer, &arena);
+    parser.parse();
+    return parser.getTree();
+}
+
+static TreeNode* standardizeProgram(const string& source, TreeArena& arena) {
+    TreeStandardizer standardizer(&arena);
+    return standardizer.standardizeTree(parseProgram(source, arena));
+}
+
+/**
+ * Input generators
+ */
+static string lexerInput(size_t bytes) {
+    const char* snippet = "let rec f x y = x gr 0 -> f (x - 1) (y aug 'str') | (y, Order y) // note\n"
+            "in Print (f 10 nil, 12 * 3 ** 2 >= 100 & not false)\n";
+    string source;
+    while(source.size() < bytes)
+        source += snippet;
+    return source;
+}
+
+static string deepConditional(int depth) {
+    ostringstream oss;
+    oss << "let x = 3 in ";
+    for(int i = 0; i < depth; i++)
+        oss << "x eq " << i << " -> " << i << " | ";
+    oss << "0\n";
+    return oss.str();
+}
+
+static string deepParentheses(int depth) {
+    return "Print " + string(depth, '(') + "1" + string(depth, ')') + "\n";
+}
+
+static string wideSum(int terms) {
+    ostringstream oss;
+    oss << "Print (0";
+    for(int i = 0; i < terms; i++)
+        oss << " + x" << i << " * " << i;
+    oss << ")\n";
+    return oss.str();
+}
+
+static string wideTuple(int terms) {
+    ostringstream oss;
+    oss << "Print (0";
+    for(int i = 0; i < terms; i++)
+        oss << ", f " << i;
+    oss << ")\n";
+    return oss.str();
+}
+
+static string manyFunctions(int count) {
+    ostringstream oss;
+    oss << "let f0 x = x + 1\n";
+    for(int i = 1; i < count; i++)
+        oss << "in let f" << i << " x y = f" << i - 1 << " (x * y) + (fn z. z - " << i << ") y\n";
+    oss << "in Print (f" << count - 1 << " 2 3)\n";
+    return oss.str();
+}
+
+static void lexerBenchmarks() {
+    size_t sizes[] = { 1024, 16 * 1024, 256 * 1024 };
+    for(unsigned int i = 0; i < 3; i++) {
+        string source = lexerInput(sizes[i]);
+        ostringstream name;
+        name << "lexer/bytes=" << sizes[i];
+        runBenchmark(name.str(), (int)(2 * 1024 * 1024 / sizes[i]) + 4, [&source](int ops, BatchTimer& timer) {
+            for(int op = 0; op < ops; op++) {
+                timer.start();
+                Lexer lexer(source);
+                timer.stop();
+                sink = lexer.tokenCount();
+            }
+        });
+    }
+}
+
+static void parseBenchmark(const string& name, const string& source, int ops) {
+    runBenchmark(name, ops, [&source](int ops, BatchTimer& timer) {
+        for(int op = 0; op < ops; op++) {
+            Lexer lexer(source);
+            TreeArena arena;
+            timer.start();
+            Parser parser(&lexer, &arena);
+            parser.parse();
+            timer.stop();
+            sink = arena.nodeCount();
+        }
+    });
+}
+
+static void parserBenchmarks() {
+    parseBenchmark("parser/deep-conditional=200", deepConditional(200), 200);
+    parseBenchmark("parser/deep-parentheses=500", deepParentheses(500), 200);
+    parseBenchmark("parser/wide-sum=2000", wideSum(2000), 50);
+    parseBenchmark("parser/wide-tuple=2000", wideTuple(2000), 50);
+}
+
+typedef TreeNode* (TreeStandardizer::*Transform)(TreeNode*);
+
+/**
+ * Times one transform: trees are parsed up front, the transform applied to
+ * the selected node of each is what gets timed
+ */
+static void transformBenchmark(const string& name, const string& source, bool onLeftChild, Transform transform) {
+    runBenchmark(name, 2000, [&](int ops, BatchTimer& timer) {
+        TreeArena arena;
+        TreeStandardizer standardizer(&arena);
+        vector<TreeNode*> targets;
+        for(int op = 0; op < ops; op++) {
+            TreeNode* root = parseProgram(source, arena);
+            targets.push_back(onLeftChild ? root->left : root);
+        }
+        timer.start();
+        for(int op = 0; op < ops; op++)
+            sink = (size_t)(standardizer.*transform)(targets[op]);
+        timer.stop();
+    });
+}
+
+static void standardizerBenchmarks() {
+    transformBenchmark("standardize/let", "let x = 1 in x", false, &TreeStandardizer::processLetExpression);
+    transformBenchmark("standardize/where", "x where x = 1", false, &TreeStandardizer::processWhereExpression);
+    transformBenchmark("standardize/lambda", "fn x y z. x", false, &TreeStandardizer::processLambdaExpression);
+    transformBenchmark("standardize/function-form", "let f x y = x in f", true, &TreeStandardizer::processFunctionForm);
+    transformBenchmark("standardize/within", "let x = 1 within y = x in y", true, &TreeStandardizer::processWithinExpression);
+    transformBenchmark("standardize/at", "a @ f b", false, &TreeStandardizer::processAtExpression);
+    transformBenchmark("standardize/and", "let x = 1 and y = 2 and z = 3 in x", true, &TreeStandardizer::processAndExpression);
+    transformBenchmark("standardize/rec", "let rec f = fn x. x in f", true, &TreeStandardizer::processRecExpression);
+
+    string program = manyFunctions(50);
+    runBenchmark("standardize/tree-functions=50", 200, [&program](int ops, BatchTimer& timer) {
+        for(int op = 0; op < ops; op++) {
+            TreeArena arena;
+            TreeNode* root = parseProgram(program, arena);
+            TreeStandardizer standardizer(&arena);
+            timer.start();
+            sink = (size_t)standardizer.standardizeTree(root);
+            timer.stop();
+        }
+    });
+}
+
+/**
+ * Machine internals, reached through the friend declaration in CSEMachine
+ */
+class MachineBenchmark {
+public:
+    static void controlStructures(const string& name, const string& source, int ops) {
+        runBenchmark(name, ops, [&source](int ops, BatchTimer& timer) {
+            TreeArena arena;
+            TreeNode* root = standardizeProgram(source, arena);
+            for(int op = 0; op < ops; op++) {
+                CSEMachine machine(root, &arena);
+                timer.start();
+                machine.createControlStructures(root);
+                timer.stop();
+                sink = machine.code->deltas.size();
+            }
+        });
+    }
+
+    /**
+     * Looks up a variable bound in the outermost environment from the end of
+     * a chain of depth environments, each holding two bindings of its own
+     */
+    static void environmentLookup(int depth) {
+        ostringstream name;
+        name << "machine/lookup-depth=" << depth;
+        runBenchmark(name.str(), 100000, [depth](int ops, BatchTimer& timer) {
+            CSEMachine machine(NULL, NULL);
+            Environment outermost = { -1, 0, 1 };
+            machine.environments.push_back(outermost);
+            machine.bindings.push_back(Binding());
+            machine.bindings.back().name = "x";
+            machine.bindings.back().value = Token("1", Lexer::INT);
+            for(int env = 1; env <= depth; env++) {
+                ostringstream local;
+                local << "v" << env;
+                Environment record = { env - 1, (unsigned int)machine.bindings.size(), 2 };
+                machine.environments.push_back(record);
+                machine.bindings.push_back(Binding());
+                machine.bindings.back().name = local.str();
+                machine.bindings.back().value = Token("2", Lexer::INT);
+                machine.bindings.push_back(Binding());
+                machine.bindings.back().name = "n";
+                machine.bindings.back().value = Token("3", Lexer::INT);
+            }
+            machine.currEnv = depth;
+            string variable("x");
+            size_t found = 0;
+            timer.start();
+            for(int op = 0; op < ops; op++)
+                found += machine.lookupVariable(variable) != NULL;
+            timer.stop();
+            sink = found;
+        });
+    }
+
+    static void applyOperator(const string& name, const Token& first, const Token& second, const Token& op) {
+        runBenchmark(name, 200000, [&](int ops, BatchTimer& timer) {
+            CSEMachine machine(NULL, NULL);
+            size_t total = 0;
+            timer.start();
+            for(int i = 0; i < ops; i++)
+                total += machine.applyOperator(first, second, op).value.size();
+            timer.stop();
+            sink = total;
+        });
+    }
+};
+
+static void machineBenchmarks() {
+    MachineBenchmark::controlStructures("machine/control-structures-functions=50", manyFunctions(50), 200);
+    MachineBenchmark::controlStructures("machine/control-structures-sum=2000", wideSum(2000), 50);
+
+    int depths[] = { 1, 4, 16, 64, 256 };
+    for(unsigned int i = 0; i < 5; i++)
+        MachineBenchmark::environmentLookup(depths[i]);
+
+    Token seven("7", Lexer::INT), five("5", Lexer::INT);
+    Token text("'rpal'", Lexer::STR), yes("true", "true"), no("false", "false");
+    MachineBenchmark::applyOperator("machine/apply-int-add", seven, five, Token("+", Lexer::OPT));
+    MachineBenchmark::applyOperator("machine/apply-int-mul", seven, five, Token("*", Lexer::OPT));
+    MachineBenchmark::applyOperator("machine/apply-int-gr", seven, five, Token("gr", "gr"));
+    MachineBenchmark::applyOperator("machine/apply-str-eq", text, text, Token("eq", "eq"));
+    MachineBenchmark::applyOperator("machine/apply-bool-and", yes, no, Token("&", "&"));
+}
+
+int main(int argc, char* argv[]) {
+    if(argc > 1)
+        nameFilter = argv[1];
+
+    cout << left << setw(42) << "benchmark" << right << setw(8) << "ops"
+         << setw(14) << "ns/op" << setw(12) << "allocs/op" << endl;
+    lexerBenchmarks();
+    parserBenchmarks();
+    standardizerBenchmarks();
+    machineBenchmarks();
+    return 0;
+}
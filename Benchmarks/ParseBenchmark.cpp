@@ -0,0 +1,136 @@
+/**
+ * Parse Throughput Benchmark
+ * Measures how fast the lexer and parser get through large, expression-heavy
+ * RPAL programs. Inputs are generated in memory so the numbers do not depend on
+ * file system caching. Lexing and parsing are timed separately and reported as
+ * best-of-N wall time, tokens per second and source megabytes per second.
+ *
+ * Usage: parsebench [terms] [repetitions]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Lexer.h"
+#include "Parser.h"
+#include "TreeArena.h"
+
+using namespace std;
+
+/**
+ * Input generators - each returns a program whose bulk is one long expression
+ */
+static string arithmeticProgram(int terms) {
+    const char* ops[] = { " + ", " - ", " * ", " / ", " ** " };
+    ostringstream oss;
+    oss << "let x = 7 and y = 3 in Print (x";
+    for(int i = 0; i < terms; i++)
+        oss << ops[i % 5] << (i % 3 == 0 ? "y" : (i % 3 == 1 ? "x" : "2"));
+    oss << ")\n";
+    return oss.str();
+}
+
+static string booleanProgram(int terms) {
+    ostringstream oss;
+    oss << "let a = true and b = false in Print (a";
+    for(int i = 0; i < terms; i++) {
+        switch(i % 4) {
+            case 0: oss << " & not b"; break;
+            case 1: oss << " or x" << i << " gr " << i; break;
+            case 2: oss << " & (a or b)"; break;
+            default: oss << " or " << i << " eq " << i; break;
+        }
+    }
+    oss << ")\n";
+    return oss.str();
+}
+
+static string applicationProgram(int terms) {
+    ostringstream oss;
+    oss << "let f x y = x + y in Print (f 1 2";
+    for(int i = 0; i < terms; i++)
+        oss << (i % 2 == 0 ? " + f " : " - f ") << i << " (f x" << i << " 'str')";
+    oss << ")\n";
+    return oss.str();
+}
+
+static string tupleProgram(int terms) {
+    ostringstream oss;
+    oss << "Print (nil aug 0";
+    for(int i = 0; i < terms; i++)
+        oss << (i % 2 == 0 ? ", " : " aug ") << "(n" << i << " ls " << i << " -> " << i << " | -" << i << ")";
+    oss << ")\n";
+    return oss.str();
+}
+
+typedef chrono::steady_clock Clock;
+
+static double elapsedSeconds(Clock::time_point start) {
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Runs one workload: lexes and parses the source repeatedly and reports the best run
+ */
+static void runWorkload(const string& name, const string& source, int repetitions) {
+    vector<double> lexTimes;
+    vector<double> parseTimes;
+    size_t tokenCount = 0;
+    size_t nodeCount = 0;
+
+    for(int r = 0; r < repetitions; r++) {
+        Clock::time_point start = Clock::now();
+        Lexer lexer(source);
+        lexTimes.push_back(elapsedSeconds(start));
+
+        TreeArena arena;
+        Parser parser(&lexer, &arena);
+        start = Clock::now();
+        parser.parse();
+        parseTimes.push_back(elapsedSeconds(start));
+
+        nodeCount = arena.nodeCount();
+        tokenCount = lexer.tokenCount();
+    }
+
+    double lexBest = *min_element(lexTimes.begin(), lexTimes.end());
+    double parseBest = *min_element(parseTimes.begin(), parseTimes.end());
+    double megabytes = source.size() / (1024.0 * 1024.0);
+
+    cout << left << setw(12) << name
+         << right << setw(10) << tokenCount
+         << setw(10) << nodeCount
+         << fixed << setprecision(2)
+         << setw(11) << lexBest * 1e3
+         << setw(11) << parseBest * 1e3
+         << setw(10) << parseBest * 1e9 / tokenCount
+         << setw(11) << tokenCount / parseBest / 1e6
+         << setw(10) << megabytes / (lexBest + parseBest)
+         << endl;
+}
+
+int main(int argc, char* argv[]) {
+    int terms = argc > 1 ? atoi(argv[1]) : 100000;
+    int repetitions = argc > 2 ? atoi(argv[2]) : 5;
+
+    cout << left << setw(12) << "workload"
+         << right << setw(10) << "tokens"
+         << setw(10) << "nodes"
+         << setw(11) << "lex ms"
+         << setw(11) << "parse ms"
+         << setw(10) << "ns/token"
+         << setw(11) << "Mtok/s"
+         << setw(10) << "MB/s"
+         << endl;
+
+    runWorkload("arithmetic", arithmeticProgram(terms), repetitions);
+    runWorkload("boolean", booleanProgram(terms), repetitions);
+    runWorkload("application", applicationProgram(terms), repetitions);
+    runWorkload("tuple", tupleProgram(terms), repetitions);
+    return 0;
+}
@@ -0,0 +1,374 @@
+/**
+ * Synthetic Program Generator and Scaling Report
+ * Emits valid RPAL programs of a chosen shape and size together with the
+ * output they must print, and measures how each interpreter stage scales as
+ * the size grows.
+ *
+ * Shapes stress one dimension each:
+ *   tokens     one long arithmetic expression of n terms
+ *   depth      conditionals nested n deep
+ *   lets       a chain of n nested let bindings
+ *   wheres     a chain of n nested where clauses
+ *   bindings   one let with n simultaneous and-bindings
+ *   tuple      a tuple n elements wide
+ *   recursion  a non-tail recursive function n calls deep
+ *   string     a string of n pieces built by Conc
+ *
+ * The scaling report runs the interpreter on each shape over a geometric range
+ * of sizes, checks every output, and fits the growth exponent of each stage's
+ * time (the slope of log time against log size). Stages growing faster than
+ * SUPERLINEAR_EXPONENT are flagged.
+ *
+ * Usage: rpalgen <shape> <size>                 program on stdout
+ *        rpalgen --expected <shape> <size>      expected output on stdout
+ *        rpalgen --scale [--interpreter=<path>] [--from=<n>] [--to=<n>]
+ *                [--factor=<n>] [shape...]
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "BenchSupport.h"
+
+using namespace std;
+
+static const double SUPERLINEAR_EXPONENT = 1.3;    // Growth exponent above which a stage is flagged
+static const double MIN_FIT_MS = 1.0;              // Shorter timings are too noisy to fit
+static const int RUNS_PER_SIZE = 3;                // Best-of runs at each size
+
+// A generated program and the output it must print
+struct GeneratedProgram {
+    string source;
+    string expected;
+};
+
+static string itos(long long value) {
+    ostringstream oss;
+    oss << value;
+    return oss.str();
+}
+
+/**
+ * Shape generators
+ */
+static GeneratedProgram tokensProgram(int n) {
+    GeneratedProgram program;
+    ostringstream oss;
+    long long total = 1;
+    oss << "Print (1";
+    for(int i = 0; i < n; i++) {
+        int term = i % 9 + 1;
+        oss << (i % 3 == 2 ? " - " : " + ") << term;
+        total += i % 3 == 2 ? -term : term;
+    }
+    oss << ")\n";
+    program.source = oss.str();
+    program.expected = itos(total);
+    return program;
+}
+
+static GeneratedProgram depthProgram(int n) {
+    GeneratedProgram program;
+    ostringstream oss;
+    oss << "let x = " << n - 1 << " in Print (";
+    for(int i = 0; i < n; i++)
+        oss << "x eq " << i << " -> " << i << " |\n";
+    oss << "-1)\n";
+    program.source = oss.str();
+    program.expected = itos(n - 1);
+    return program;
+}
+
+static GeneratedProgram letsProgram(int n) {
+    GeneratedProgram program;
+    ostringstream oss;
+    oss << "let x1 = 1\n";
+    for(int i = 2; i <= n; i++)
+        oss << "in let x" << i << " = x" << i - 1 << " + 1\n";
+    oss << "in Print x" << n << "\n";
+    program.source = oss.str();
+    program.expected = itos(n);
+    return program;
+}
+
+static GeneratedProgram wheresProgram(int n) {
+    GeneratedProgram program;
+    ostringstream oss;
+    oss << string(n - 1, '(') << "Print x" << n << "\n";
+    for(int i = n; i >= 2; i--)
+        oss << "where x" << i << " = x" << i - 1 << " + 1)\n";
+    oss << "where x1 = 1\n";
+    program.source = oss.str();
+    program.expected = itos(n);
+    return program;
+}
+
+static GeneratedProgram bindingsProgram(int n) {
+    GeneratedProgram program;
+    ostringstream oss;
+    oss << "let x1 = 1";
+    for(int i = 2; i <= n; i++)
+        oss << "\nand x" << i << " = " << i % 10;
+    oss << "\nin Print (x1";
+    long long total = 1;
+    for(int i = 2; i <= n; i++) {
+        oss << " + x" << i;
+        total += i % 10;
+    }
+    oss << ")\n";
+    program.source = oss.str();
+    program.expected = itos(total);
+    return program;
+}
+
+static GeneratedProgram tupleProgram(int n) {
+    GeneratedProgram program;
+    ostringstream oss;
+    oss << "let T = (1";
+    for(int i = 2; i <= n; i++)
+        oss << ", " << i;
+    oss << ")\nin Print (Order T, T " << n << ")\n";
+    program.source = oss.str();
+    program.expected = "(" + itos(n) + ", " + itos(n) + ")";
+    return program;
+}
+
+static GeneratedProgram recursionProgram(int n) {
+    GeneratedProgram program;
+    program.source = "let rec f n = n eq 0 -> 0 | 1 + f (n - 1)\nin Print (f " + itos(n) + ")\n";
+    program.expected = itos(n);
+    return program;
+}
+
+static GeneratedProgram stringProgram(int n) {
+    GeneratedProgram program;
+    program.source = "let rec repeat n = n eq 0 -> '' | Conc 'ab' (repeat (n - 1))\nin Print (repeat "
+            + itos(n) + ")\n";
+    for(int i = 0; i < n; i++)
+        program.expected += "ab";
+    return program;
+}
+
+struct Shape {
+    const char* name;
+    GeneratedProgram (*generate)(int size);
+};
+
+static const Shape shapes[] = {
+    { "tokens", tokensProgram },
+    { "depth", depthProgram },
+    { "lets", letsProgram },
+    { "wheres", wheresProgram },
+    { "bindings", bindingsProgram },
+    { "tuple", tupleProgram },
+    { "recursion", recursionProgram },
+    { "string", stringProgram },
+};
+static const int SHAPE_COUNT = sizeof(shapes) / sizeof(shapes[0]);
+
+static const Shape* findShape(const string& name) {
+    for(int i = 0; i < SHAPE_COUNT; i++)
+        if(name == shapes[i].name)
+            return &shapes[i];
+    return NULL;
+}
+
+/**
+ * Stages reported by the interpreter's --stats=json, plus the whole run
+ */
+static const char* stageKeys[] = { "lex", "parse", "standardize", "control_structures", "evaluate" };
+static const char* stageLabels[] = { "lex", "parse", "standard", "control", "evaluate", "total" };
+static const int STAGE_COUNT = 6;
+
+struct ScaleOptions {
+    ScaleOptions() : interpreter("./myrpal"), from(256), to(16384), factor(2) {}
+    string interpreter;
+    int from;
+    int to;
+    int factor;
+    vector<string> shapes;
+};
+
+/**
+ * Least-squares slope of log(ms) against log(size), over the points long
+ * enough to measure; returns a negative value when fewer than two qualify
+ */
+static double growthExponent(const vector<int>& sizes, const vector<double>& times) {
+    vector<double> xs, ys;
+    for(unsigned int i = 0; i < sizes.size(); i++) {
+        if(times[i] < MIN_FIT_MS)
+            continue;
+        xs.push_back(log((double)sizes[i]));
+        ys.push_back(log(times[i]));
+    }
+    if(xs.size() < 2)
+        return -1;
+    double meanX = 0, meanY = 0;
+    for(unsigned int i = 0; i < xs.size(); i++) {
+        meanX += xs[i];
+        meanY += ys[i];
+    }
+    meanX /= xs.size();
+    meanY /= xs.size();
+    double covariance = 0, variance = 0;
+    for(unsigned int i = 0; i < xs.size(); i++) {
+        covariance += (xs[i] - meanX) * (ys[i] - meanY);
+        variance += (xs[i] - meanX) * (xs[i] - meanX);
+    }
+    return covariance / variance;
+}
+
+/**
+ * Runs one shape over the size range and prints its timings and exponents;
+ * returns the number of stages flagged as super-linear, or -1 on a failed run
+ */
+static int scaleShape(const ScaleOptions& options, const Shape& shape) {
+    string programPath = temporaryFile("rpalgen-program");
+    string outputPath = temporaryFile("rpalgen-out");
+    string statsPath = temporaryFile("rpalgen-stats");
+    vector<string> args;
+    args.push_back("--stats=json");
+    args.push_back("--stats-file=" + statsPath);
+    args.push_back(programPath);
+
+    cout << shape.name << endl;
+    cout << right << setw(10) << "size";
+    for(int s = 0; s < STAGE_COUNT; s++)
+        cout << setw(11) << stageLabels[s];
+    cout << setw(10) << "rss kb" << endl;
+
+    vector<int> sizes;
+    vector<vector<double> > times(STAGE_COUNT);
+    bool failed = false;
+    for(long long size = options.from; size <= options.to && !failed; size *= options.factor) {
+        GeneratedProgram program = shape.generate((int)size);
+        ofstream(programPath.c_str()) << program.source;
+
+        vector<double> best(STAGE_COUNT, 0);
+        long peakRssKb = 0;
+        for(int run = 0; run < RUNS_PER_SIZE; run++) {
+            ChildRun child = runChild(options.interpreter, args, outputPath);
+            string output, stats;
+            if(!child.ok || !readFile(outputPath, output) || output != program.expected
+                    || !readFile(statsPath, stats)) {
+                cout << setw(10) << size << "  " << (child.ok ? "wrong output" : "failed") << endl;
+                failed = true;
+                break;
+            }
+            vector<double> stageMs(STAGE_COUNT, 0);
+            for(int s = 0; s < STAGE_COUNT - 1; s++)
+                stageMs[s] = jsonNumber(stats, stageKeys[s]);
+            stageMs[STAGE_COUNT - 1] = child.wallMs;
+            for(int s = 0; s < STAGE_COUNT; s++)
+                if(run == 0 || stageMs[s] < best[s])
+                    best[s] = stageMs[s];
+            peakRssKb = max(peakRssKb, child.peakRssKb);
+        }
+        if(failed)
+            break;
+
+        sizes.push_back((int)size);
+        cout << setw(10) << size << fixed << setprecision(2);
+        for(int s = 0; s < STAGE_COUNT; s++) {
+            times[s].push_back(best[s]);
+            cout << setw(11) << best[s];
+        }
+        cout << setw(10) << peakRssKb << endl;
+    }
+    unlink(programPath.c_str());
+    unlink(outputPath.c_str());
+    unlink(statsPath.c_str());
+
+    int flagged = 0;
+    cout << setw(10) << "exponent";
+    for(int s = 0; s < STAGE_COUNT; s++) {
+        double exponent = growthExponent(sizes, times[s]);
+        if(exponent < 0)
+            cout << setw(11) << "-";
+        else
+            cout << setw(10) << setprecision(2) << exponent << (exponent > SUPERLINEAR_EXPONENT ? "!" : " ");
+        if(exponent > SUPERLINEAR_EXPONENT && s < STAGE_COUNT - 1)
+            flagged++;
+    }
+    cout << endl;
+    for(int s = 0; s < STAGE_COUNT - 1; s++) {
+        double exponent = growthExponent(sizes, times[s]);
+        if(exponent > SUPERLINEAR_EXPONENT)
+            cout << "  super-linear: " << stageLabels[s] << " grows as size^" << setprecision(2) << exponent << endl;
+    }
+    cout << endl;
+    return failed ? -1 : flagged;
+}
+
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " <shape> <size>" << endl;
+    cerr << "       " << program << " --expected <shape> <size>" << endl;
+    cerr << "       " << program << " --scale [--interpreter=<path>] [--from=<n>] [--to=<n>] [--factor=<n>] [shape...]" << endl;
+    cerr << "Shapes:";
+    for(int i = 0; i < SHAPE_COUNT; i++)
+        cerr << " " << shapes[i].name;
+    cerr << endl;
+}
+
+static int scaleReport(int argc, char* argv[]) {
+    ScaleOptions options;
+    for(int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if(arg.compare(0, 14, "--interpreter=") == 0)
+            options.interpreter = arg.substr(14);
+        else if(arg.compare(0, 7, "--from=") == 0)
+            options.from = atoi(arg.c_str() + 7);
+        else if(arg.compare(0, 5, "--to=") == 0)
+            options.to = atoi(arg.c_str() + 5);
+        else if(arg.compare(0, 9, "--factor=") == 0)
+            options.factor = atoi(arg.c_str() + 9);
+        else if(findShape(arg) != NULL)
+            options.shapes.push_back(arg);
+        else {
+            cerr << "Error: Unknown option or shape '" << arg << "'" << endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if(options.from < 1 || options.factor < 2 || options.to < options.from) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if(options.shapes.empty())
+        for(int i = 0; i < SHAPE_COUNT; i++)
+            options.shapes.push_back(shapes[i].name);
+
+    bool failed = false;
+    int flagged = 0;
+    for(unsigned int i = 0; i < options.shapes.size(); i++) {
+        int result = scaleShape(options, *findShape(options.shapes[i]));
+        if(result < 0)
+            failed = true;
+        else
+            flagged += result;
+    }
+    cout << flagged << " super-linear stage(s) flagged" << endl;
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc > 1 && string(argv[1]) == "--scale")
+        return scaleReport(argc, argv);
+
+    bool expected = argc > 1 && string(argv[1]) == "--expected";
+    int first = expected ? 2 : 1;
+    if(argc != first + 2 || findShape(argv[first]) == NULL || atoi(argv[first + 1]) < 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    GeneratedProgram program = findShape(argv[first])->generate(atoi(argv[first + 1]));
+    cout << (expected ? program.expected : program.source);
+    return 0;
+}
@@ -0,0 +1,280 @@
+/**
+ * Big Integer Implementation
+ *
+ * Sign and magnitude; zero has no limbs and is never negative. Long
+ * division is Knuth's algorithm D: both operands are scaled so that the
+ * divisor's top limb is at least half the base, and each quotient limb
+ * estimated from the top limbs is then at most two too large.
+ */
+
+#include "BigInteger.h"
+#include <algorithm>
+
+using namespace std;
+
+static const unsigned int BASE = 1000000000;
+static const unsigned int BASE_DIGITS = 9;
+
+// Below this many limbs in either operand the schoolbook product is faster
+static const size_t KARATSUBA_THRESHOLD = 32;
+
+BigInteger::BigInteger() {
+	negative = false;
+}
+
+BigInteger::BigInteger(long long value) {
+	negative = value < 0;
+	unsigned long long magnitude = negative ? 0ull - (unsigned long long)value : (unsigned long long)value;
+	while(magnitude != 0) {
+		limbs.push_back(magnitude % BASE);
+		magnitude /= BASE;
+	}
+}
+
+BigInteger::BigInteger(const string& text) {
+	size_t start = 0;
+	negative = false;
+	if(start < text.size() && (text[start] == '-' || text[start] == '+'))
+		negative = text[start++] == '-';
+	size_t end = start;
+	while(end < text.size() && text[end] >= '0' && text[end] <= '9')
+		end++;
+	// Nine digits to a limb, from the least significant end
+	for(size_t stop = end; stop > start; ) {
+		size_t first = stop >= start + BASE_DIGITS ? stop - BASE_DIGITS : start;
+		unsigned int limb = 0;
+		for(size_t i = first; i < stop; i++)
+			limb = limb * 10 + (text[i] - '0');
+		limbs.push_back(limb);
+		stop = first;
+	}
+	trim(limbs);
+	if(limbs.empty())
+		negative = false;
+}
+
+string BigInteger::toString() const {
+	if(limbs.empty())
+		return "0";
+	string text = negative ? "-" : "";
+	text += to_string(limbs.back());
+	for(size_t i = limbs.size() - 1; i > 0; i--) {
+		string limb = to_string(limbs[i - 1]);
+		text.append(BASE_DIGITS - limb.size(), '0');
+		text += limb;
+	}
+	return text;
+}
+
+void BigInteger::trim(Magnitude& magnitude) {
+	while(!magnitude.empty() && magnitude.back() == 0)
+		magnitude.pop_back();
+}
+
+BigInteger BigInteger::withSign(Magnitude magnitude, bool negative) {
+	BigInteger result;
+	trim(magnitude);
+	result.limbs.swap(magnitude);
+	result.negative = negative && !result.limbs.empty();
+	return result;
+}
+
+int BigInteger::compareMagnitudes(const Magnitude& a, const Magnitude& b) {
+	if(a.size() != b.size())
+		return a.size() < b.size() ? -1 : 1;
+	for(size_t i = a.size(); i > 0; i--) {
+		if(a[i - 1] != b[i - 1])
+			return a[i - 1] < b[i - 1] ? -1 : 1;
+	}
+	return 0;
+}
+
+int BigInteger::compare(const BigInteger& a, const BigInteger& b) {
+	if(a.negative != b.negative)
+		return a.negative ? -1 : 1;
+	int magnitude = compareMagnitudes(a.limbs, b.limbs);
+	return a.negative ? -magnitude : magnitude;
+}
+
+int BigInteger::compareDecimal(const string& a, const string& b) {
+	long long x, y;
+	if(toWord(a, x) && toWord(b, y))
+		return x < y ? -1 : x > y;
+	return compare(BigInteger(a), BigInteger(b));
+}
+
+BigInteger::Magnitude BigInteger::addMagnitudes(const Magnitude& a, const Magnitude& b) {
+	Magnitude sum;
+	sum.reserve(max(a.size(), b.size()) + 1);
+	unsigned int carry = 0;
+	for(size_t i = 0; i < a.size() || i < b.size() || carry != 0; i++) {
+		unsigned int limb = carry + (i < a.size() ? a[i] : 0) + (i < b.size() ? b[i] : 0);
+		carry = limb >= BASE;
+		sum.push_back(carry ? limb - BASE : limb);
+	}
+	return sum;
+}
+
+BigInteger::Magnitude BigInteger::subtractMagnitudes(const Magnitude& a, const Magnitude& b) {
+	Magnitude difference(a);
+	unsigned int borrow = 0;
+	for(size_t i = 0; i < difference.size() && (i < b.size() || borrow != 0); i++) {
+		unsigned int subtrahend = (i < b.size() ? b[i] : 0) + borrow;
+		borrow = difference[i] < subtrahend;
+		difference[i] = borrow ? difference[i] + BASE - subtrahend : difference[i] - subtrahend;
+	}
+	trim(difference);
+	return difference;
+}
+
+BigInteger::Magnitude BigInteger::multiplySmall(const Magnitude& a, unsigned int factor) {
+	Magnitude product;
+	product.reserve(a.size() + 1);
+	unsigned long long carry = 0;
+	for(size_t i = 0; i < a.size(); i++) {
+		unsigned long long limb = (unsigned long long)a[i] * factor + carry;
+		product.push_back(limb % BASE);
+		carry = limb / BASE;
+	}
+	if(carry != 0)
+		product.push_back(carry);
+	trim(product);
+	return product;
+}
+
+BigInteger::Magnitude BigInteger::schoolbookMultiply(const Magnitude& a, const Magnitude& b) {
+	Magnitude product(a.size() + b.size(), 0);
+	for(size_t i = 0; i < a.size(); i++) {
+		unsigned long long carry = 0;
+		for(size_t j = 0; j < b.size(); j++) {
+			unsigned long long limb = product[i + j] + (unsigned long long)a[i] * b[j] + carry;
+			product[i + j] = limb % BASE;
+			carry = limb / BASE;
+		}
+		for(size_t k = i + b.size(); carry != 0; k++) {
+			unsigned long long limb = product[k] + carry;
+			product[k] = limb % BASE;
+			carry = limb / BASE;
+		}
+	}
+	trim(product);
+	return product;
+}
+
+/**
+ * Karatsuba: with a = a1 B^m + a0 and b = b1 B^m + b0, three half-size
+ * products give a b = z2 B^2m + (z1 - z2 - z0) B^m + z0, where
+ * z1 = (a0 + a1)(b0 + b1)
+ */
+BigInteger::Magnitude BigInteger::karatsubaMultiply(const Magnitude& a, const Magnitude& b) {
+	size_t half = max(a.size(), b.size()) / 2;
+	Magnitude a0(a.begin(), a.begin() + min(half, a.size()));
+	Magnitude a1(a.begin() + min(half, a.size()), a.end());
+	Magnitude b0(b.begin(), b.begin() + min(half, b.size()));
+	Magnitude b1(b.begin() + min(half, b.size()), b.end());
+	trim(a0);
+	trim(b0);
+	Magnitude z0 = multiplyMagnitudes(a0, b0);
+	Magnitude z2 = multiplyMagnitudes(a1, b1);
+	Magnitude z1 = multiplyMagnitudes(addMagnitudes(a0, a1), addMagnitudes(b0, b1));
+	z1 = subtractMagnitudes(subtractMagnitudes(z1, z0), z2);
+
+	Magnitude product(a.size() + b.size() + 1, 0);
+	const Magnitude* parts[] = { &z0, &z1, &z2 };
+	for(size_t part = 0; part < 3; part++) {
+		const Magnitude& z = *parts[part];
+		unsigned int carry = 0;
+		size_t k = part * half;
+		for(size_t i = 0; i < z.size() || carry != 0; i++, k++) {
+			unsigned int limb = product[k] + carry + (i < z.size() ? z[i] : 0);
+			carry = limb >= BASE;
+			product[k] = carry ? limb - BASE : limb;
+		}
+	}
+	trim(product);
+	return product;
+}
+
+BigInteger::Magnitude BigInteger::multiplyMagnitudes(const Magnitude& a, const Magnitude& b) {
+	if(a.empty() || b.empty())
+		return Magnitude();
+	if(a.size() < KARATSUBA_THRESHOLD || b.size() < KARATSUBA_THRESHOLD)
+		return schoolbookMultiply(a, b);
+	return karatsubaMultiply(a, b);
+}
+
+BigInteger::Magnitude BigInteger::divideMagnitudes(const Magnitude& a, const Magnitude& b) {
+	if(compareMagnitudes(a, b) < 0)
+		return Magnitude();
+	Magnitude quotient(a.size(), 0);
+	if(b.size() == 1) {
+		unsigned long long remainder = 0;
+		for(size_t i = a.size(); i > 0; i--) {
+			unsigned long long current = remainder * BASE + a[i - 1];
+			quotient[i - 1] = current / b[0];
+			remainder = current % b[0];
+		}
+		trim(quotient);
+		return quotient;
+	}
+	unsigned int scale = BASE / (b.back() + 1);
+	Magnitude dividend = multiplySmall(a, scale);
+	Magnitude divisor = multiplySmall(b, scale);
+	size_t n = divisor.size();
+	Magnitude remainder;
+	quotient.resize(dividend.size(), 0);
+	for(size_t i = dividend.size(); i > 0; i--) {
+		remainder.insert(remainder.begin(), dividend[i - 1]);
+		trim(remainder);
+		unsigned long long top = (remainder.size() > n ? (unsigned long long)remainder[n] * BASE : 0)
+				+ (remainder.size() > n - 1 ? remainder[n - 1] : 0);
+		unsigned long long estimate = min<unsigned long long>(top / divisor.back(), BASE - 1);
+		Magnitude product = multiplySmall(divisor, estimate);
+		while(compareMagnitudes(product, remainder) > 0) {
+			estimate--;
+			product = subtractMagnitudes(product, divisor);
+		}
+		remainder = subtractMagnitudes(remainder, product);
+		quotient[i - 1] = estimate;
+	}
+	trim(quotient);
+	return quotient;
+}
+
+BigInteger BigInteger::operator-() const {
+	return withSign(limbs, !negative);
+}
+
+BigInteger BigInteger::operator+(const BigInteger& other) const {
+	if(negative == other.negative)
+		return withSign(addMagnitudes(limbs, other.limbs), negative);
+	if(compareMagnitudes(limbs, other.limbs) >= 0)
+		return withSign(subtractMagnitudes(limbs, other.limbs), negative);
+	return withSign(subtractMagnitudes(other.limbs, limbs), other.negative);
+}
+
+BigInteger BigInteger::operator-(const BigInteger& other) const {
+	return *this + -other;
+}
+
+BigInteger BigInteger::operator*(const BigInteger& other) const {
+	return withSign(multiplyMagnitudes(limbs, other.limbs), negative != other.negative);
+}
+
+BigInteger BigInteger::operator/(const BigInteger& other) const {
+	return withSign(divideMagnitudes(limbs, other.limbs), negative != other.negative);
+}
+
+// Exponentiation by squaring
+BigInteger BigInteger::power(unsigned long long exponent) const {
+	BigInteger result(1);
+	BigInteger base(*this);
+	while(exponent != 0) {
+		if(exponent & 1)
+			result = result * base;
+		exponent >>= 1;
+		if(exponent != 0)
+			base = base * base;
+	}
+	return result;
+}
@@ -0,0 +1,78 @@
+/**
+ * Big Integer Header
+ *
+ * Arbitrary-precision integers for the machine's arithmetic. Integer tokens
+ * keep their decimal text, and applyOperator works on it in a machine word
+ * while the operands have at most 18 digits and the result does not
+ * overflow; only then are the operands parsed into a BigInteger. Magnitudes
+ * are kept in base 10^9 limbs, least significant first, so conversion to
+ * and from the decimal text is linear. Multiplication switches from the
+ * schoolbook method to Karatsuba's once both operands are long, and
+ * division, like C's, truncates toward zero.
+ */
+
+#ifndef BIGINTEGER_H_
+#define BIGINTEGER_H_
+
+#include <string>
+#include <vector>
+
+class BigInteger {
+public:
+	BigInteger();
+	explicit BigInteger(long long value);
+	explicit BigInteger(const std::string& text);       // Optional sign, then digits up to the first non-digit, as atoi
+
+	std::string toString() const;
+	bool isZero() const { return limbs.empty(); }
+	bool isNegative() const { return negative; }
+
+	BigInteger operator-() const;
+	BigInteger operator+(const BigInteger& other) const;
+	BigInteger operator-(const BigInteger& other) const;
+	BigInteger operator*(const BigInteger& other) const;
+	BigInteger operator/(const BigInteger& other) const; // The divisor must not be zero
+	BigInteger power(unsigned long long exponent) const;
+	static int compare(const BigInteger& a, const BigInteger& b);
+
+	/**
+	 * The fast path: the value of decimal text of at most 18 digits, which
+	 * always fits a long long. False for longer or malformed text
+	 */
+	static bool toWord(const std::string& text, long long& value) {
+		size_t size = text.size();
+		size_t i = size > 0 && text[0] == '-' ? 1 : 0;
+		if(size == i || size - i > 18)
+			return false;
+		long long result = 0;
+		for(; i < size; i++) {
+			unsigned int digit = (unsigned char)text[i] - '0';
+			if(digit > 9)
+				return false;
+			result = result * 10 + digit;
+		}
+		value = text[0] == '-' ? -result : result;
+		return true;
+	}
+
+	static int compareDecimal(const std::string& a, const std::string& b);  // Numeric order of two integer texts
+
+private:
+	typedef std::vector<unsigned int> Magnitude;
+
+	bool negative;
+	Magnitude limbs;
+
+	static int compareMagnitudes(const Magnitude& a, const Magnitude& b);
+	static Magnitude addMagnitudes(const Magnitude& a, const Magnitude& b);
+	static Magnitude subtractMagnitudes(const Magnitude& a, const Magnitude& b);  // a >= b
+	static Magnitude multiplyMagnitudes(const Magnitude& a, const Magnitude& b);
+	static Magnitude schoolbookMultiply(const Magnitude& a, const Magnitude& b);
+	static Magnitude karatsubaMultiply(const Magnitude& a, const Magnitude& b);
+	static Magnitude multiplySmall(const Magnitude& a, unsigned int factor);
+	static Magnitude divideMagnitudes(const Magnitude& a, const Magnitude& b);
+	static void trim(Magnitude& magnitude);
+	static BigInteger withSign(Magnitude magnitude, bool negative);
+};
+
+#endif /* BIGINTEGER_H_ */
@@ -1,6 +1,10 @@
 
 #include "CSEMachine.h"
- #include "Lexer.h"
+#include "PackedInts.h"
+#include "ParallelSort.h"
+#include "PersistentMap.h"
+#include "BigInteger.h"
+#include "Lexer.h"
 #include "TreeNode.h"
 #include <string>
 #include <list>
@@ -10,413 +14,833 @@
 #include <iostream>
 #include <stack>
 #include <cmath>
+#include <climits>
 #include <utility>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
 
-typedef pair<int,string> key_pair;
+// Superinstructions replace the control sequences the machine executes most
+// often (as counted by Benchmarks/ControlNgrams.cpp) with one token each, so
+// the whole sequence costs a single dispatch and no intermediate pushes
+static const string FUSED = "fused";
 
-CSEMachine::CSEMachine() {
-	// TODO Auto-generated constructor stub
+// Lazy evaluation: a delay creates a thunk of its delta, a share pushes a
+// variable's binding without forcing it, a memo stores a forced value and
+// a restore puts back the values set aside while a thunk is forced
+static const string DELAY = "delay";
+static const string SHARE = "share";
+static const string THUNK = "thunk";
+static const string MEMO = "memo";
+static const string RESTORE = "restore";
 
+// Integer sequences, produced as they are consumed. A sequence token's value
+// names its kind and its tuple holds the state: Range (from, to), Iterate
+// (function, next value, count left or -1 when unbounded) and Elements
+// (tuple, next index), the cursor Fold uses over a tuple. A fold is a loop of
+// control tokens: fold applies the function to the accumulator and the next
+// element, next applies an Iterate's function to get the element after it
+// and advance takes that element into the state
+static const string SEQUENCE = "sequence";
+static const string FOLD = "fold";
+static const string NEXT = "next";
+static const string ADVANCE = "advance";
+
+// A builtin applied to fewer arguments than it takes. The token's value
+// names the builtin and its tuple holds the arguments so far, first first;
+// the next gamma supplies another
+static const string PARTIAL = "partial";
+
+// Arguments a builtin takes; Sort takes a comparator before its tuple when
+// it is given one. The builtins taking several take them all at once
+static unsigned int builtinArity(const string& name, const Token& firstArgument){
+	if(name == "Fold" || name == "MapPut")
+		return 3;
+	if(name == "Conc" || name == "conc" || name == "Range" || name == "Iterate" || name == "Take" || name == "Dot"
+			|| name == "Add" || name == "Mul" || name == "SortBy" || name == "BinarySearch" || name == "MapGet" || name == "MapHas")
+		return 2;
+	return name == "Sort" && firstArgument.type == "lambdaClosure" ? 2 : 1;
 }
 
-CSEMachine::~CSEMachine() {
-	// TODO Auto-generated destructor stub
+// An integer argument or piece of sequence state as a machine word. Bounds
+// and counts are limited to the 18 digits toWord reads, so the length of
+// any range still fits a word
+static long long wordArgument(const Token& argument, const string& builtin){
+	long long value;
+	if(argument.type != Lexer::INT || argument.isTuple)
+		throw runtime_error(builtin + " needs an integer, not " + argument.value);
+	if(!BigInteger::toWord(argument.value, value))
+		throw runtime_error(builtin + " of an integer too large: " + argument.value);
+	return value;
 }
 
+// Sorting with a closure. A merge token is a bottom-up merge sort waiting
+// for the comparator's verdict on the heads of two runs; its tuple holds the
+// comparator, the tuple being merged from, the one being merged into, the
+// run width and the start and both cursors of the pair of runs being merged.
+// A sort key token collects SortBy's keys: the key function, the tuple and
+// the keys so far
+static const string MERGE = "merge";
+static const string SORT_KEY = "sortkey";
+
+// Map values: the token's map holds the contents. MapEmpty stays an
+// identifier, like the builtins, and the map builtins take it as the empty map
+static const string MAP = "map";
+static const PersistentMap emptyMap;
+static const char* superinstructionNames[] = {
+	"op-var-int", "branch-op", "branch-var-int", "apply-var", "apply-var-var"
+};
 
-CSEMachine::CSEMachine(TreeNode* input){
+CSEMachine::CSEMachine() : CSEMachine(NULL, NULL) {
+}
+
+CSEMachine::~CSEMachine() {
+}
+
+CSEMachine::CSEMachine(TreeNode* input, const TreeArena* arena)
+	: trueToken("true","true"), falseToken("false","false"), dummyToken("dummy","dummy"), gammaToken("gamma","gamma") {
 	this->inputTree = input;
+	this->arena = arena;
 	this->deltaCounter = 0;
 	this->currDeltaNum = 0;
 	this->envCounter = 0;
 	this->envStack.push(0);
 	this->currEnv = 0;
-	this->envMap = map<int,int>();
 	this->printCalled = false;
+	this->stats = NULL;
+	this->profiler = NULL;
+	this->tracer = NULL;
+	this->heapProfiler = NULL;
+	this->stepCount = 0;
+	this->maxSteps = 0;
+	this->maxMemory = 0;
+	this->peakMemory = 0;
+	this->compiling = NULL;
+	this->output = &cout;
+	this->superinstructionsEnabled = true;
+	this->uncurryingEnabled = true;
+	this->flatClosuresEnabled = true;
+	this->knownCallsEnabled = true;
+	this->strictBooleans = false;
+	this->lazyEnabled = false;
+	this->reclaimedEnvironments = 0;
+}
+
+// A machine for a program another machine compiled. The options that shape
+// the control structures are the ones they were built with
+CSEMachine::CSEMachine(shared_ptr<const ControlStructures> code) : CSEMachine(NULL, NULL) {
+	this->code = code;
+	this->lazyEnabled = code->lazy;
+}
+
+// Where Print writes; std::cout unless an embedding program redirects it
+void CSEMachine::setOutput(ostream* output){
+	this->output = output;
+}
+
+// Statistics sink for --stats; NULL keeps the machine loop free of counting
+void CSEMachine::setStats(RunStats* stats){
+	this->stats = stats;
+}
+
+// Per-lambda profiler for --profile; told about every closure application and env pop
+void CSEMachine::setProfiler(LambdaProfiler* profiler){
+	this->profiler = profiler;
+}
+
+// Timeline for --trace; told about the same events as the profiler, plus builtin calls
+void CSEMachine::setTracer(ExecutionTracer* tracer){
+	this->tracer = tracer;
+}
+
+// Heap profiler for --heap-profile; charged with every environment, tuple and string created
+void CSEMachine::setHeapProfiler(HeapProfiler* heapProfiler){
+	this->heapProfiler = heapProfiler;
+}
+
+// Upper bound on machine steps for --max-steps; 0 means unlimited
+void CSEMachine::setStepLimit(unsigned long long maxSteps){
+	this->maxSteps = maxSteps;
+}
+
+// Upper bound on the memory the machine holds, in bytes as machineBytes
+// estimates it; 0 means unlimited
+void CSEMachine::setMemoryLimit(unsigned long long maxBytes){
+	this->maxMemory = maxBytes;
+}
+
+// Fusing of frequent control sequences into superinstructions; on by default
+void CSEMachine::setSuperinstructions(bool enabled){
+	this->superinstructionsEnabled = enabled;
+}
+
+// Binding of saturated curried calls in one environment; on by default
+void CSEMachine::setUncurrying(bool enabled){
+	this->uncurryingEnabled = enabled;
+}
+
+// Closures capturing just their free variables; on by default
+void CSEMachine::setFlatClosures(bool enabled){
+	this->flatClosuresEnabled = enabled;
+}
+
+// Direct entry for applications of let- and rec-bound lambdas; needs the
+// superinstructions, whose application sequences carry it. On by default
+void CSEMachine::setKnownCalls(bool enabled){
+	this->knownCallsEnabled = enabled;
+}
+
+// Both operands of or and & evaluated, as the standardized tree says, for
+// programs that print from a call in the right operand; off by default
+void CSEMachine::setStrictBooleans(bool enabled){
+	this->strictBooleans = enabled;
+}
+
+// Call-by-need evaluation for --lazy; off by default
+void CSEMachine::setLazy(bool enabled){
+	this->lazyEnabled = enabled;
+}
+
+// Builds the control structures from the tree, once; they can then be
+// handed to other machines
+shared_ptr<const ControlStructures> CSEMachine::compile(){
+	if(!code){
+		{
+			PhaseTimer timer(stats, RunStats::CONTROL_STRUCTURES);
+			createControlStructures(this->inputTree);
+		}
+		STATS_ADD(stats, deltaCount, code->deltas.size());
+	}
+	return code;
 }
 
 void CSEMachine::evaluateTree(){
-	createControlStructures(this->inputTree);
+	compile();
+	PhaseTimer timer(stats, RunStats::EVALUATE);
 	Token envToken("env",envCounter);
-	stack<Token> controlStack;
-	stack<Token> executionStack;
+	TokenStack controlStack;
+	TokenStack executionStack;
 	controlStack.push(envToken);
 	//Making parent of env 0 , -1
-	envMap[0] = -1;
+	Environment primitiveEnv = { -1, 0, 0, false };
+	environments.push_back(primitiveEnv);
 
-	vector<Token> delta0 = deltaMap[0];
-	for(int i=0;i<delta0.size();i++){
-		controlStack.push(delta0[i]);
-	}
+	pushDelta(0, controlStack);
 	executionStack.push(envToken);
-	int whileCount = 0;
 	while(controlStack.size() != 1){
-		Token currToken = controlStack.top();
+		if(maxSteps != 0 && stepCount >= maxSteps){
+			ostringstream message;
+			message << "step limit of " << maxSteps << " machine steps reached";
+			throw EvaluationLimit(EvaluationLimit::STEPS, message.str());
+		}
+		if(maxMemory != 0){
+			unsigned long long bytes = machineBytes(controlStack, executionStack);
+			if(bytes > peakMemory)
+				peakMemory = bytes;
+			if(bytes > maxMemory){
+				ostringstream message;
+				message << "memory limit of " << maxMemory << " bytes reached";
+				throw EvaluationLimit(EvaluationLimit::MEMORY, message.str());
+			}
+		}
+		stepCount++;
+		STATS_MAX(stats, peakControlDepth, controlStack.size());
+		STATS_MAX(stats, peakExecutionDepth, executionStack.size());
+		Token currToken(std::move(controlStack.top()));
 		controlStack.pop();
+#ifdef RPAL_COUNT_ALLOCATIONS
+		unsigned long long allocationsBefore = ALLOCATION_COUNT();
+		string stepKind = currToken.type;
 		processCurrentToken(currToken,controlStack,executionStack);
-		//cout<<"Inside while: "<<controlStack.size()<< endl;
-		if(whileCount > 5000){
-			break;
-		}
-		whileCount++;
+		if(stats)
+			stats->countStepAllocations(stepKind, ALLOCATION_COUNT() - allocationsBefore);
+#else
+		processCurrentToken(currToken,controlStack,executionStack);
+#endif
+		if(heapProfiler && heapProfiler->snapshotDue(stepCount))
+			snapshotHeap(executionStack);
 	}
+	if(heapProfiler)
+		snapshotHeap(executionStack);
+	STATS_ADD(stats, machineSteps, stepCount);
+	STATS_ADD(stats, environmentsCreated, environments.size() + reclaimedEnvironments);
+	STATS_ADD(stats, environmentsReclaimed, reclaimedEnvironments);
+	if(profiler)
+		profiler->finish(stepCount);
+	if(tracer)
+		tracer->finish();
 	if(printCalled == false)
-		cout<<endl;
+		*output<<endl;
 	//cout<<endl;
 	//cout<<"Execution result: "<<executionStack.top().value<<endl;
 }
 
-void CSEMachine::processCurrentToken(Token &currToken,stack<Token> &controlStack, stack<Token> &executionStack){
-	//cout<<"Control stack top: "<<currToken.type <<" Exe top: "<<executionStack.top().type<< endl;
-	//cout<<"Control stack top: "<<currToken.value <<" Exe top: "<<executionStack.top().value<< endl;
-	if(currToken.type == Lexer::OPT){
-		Token firstToken = executionStack.top();
-		executionStack.pop();
-		Token secondToken = executionStack.top();
-		executionStack.pop();
-		Token resultToken = applyOperator(firstToken, secondToken, currToken);
-		executionStack.push(resultToken);
-	}else if(currToken.type == "neg"){
-		Token firstToken = executionStack.top();
+// What the machine holds, estimated from its tables: a slot per stack entry,
+// binding and thunk and a record per environment. Tuples and strings are
+// counted as their one slot, without walking their elements or text
+unsigned long long CSEMachine::machineBytes(const TokenStack &controlStack, const TokenStack &executionStack) const{
+	return (controlStack.size() + executionStack.size()) * sizeof(Token) + bindings.size() * sizeof(Binding)
+		+ environments.size() * sizeof(Environment) + thunks.size() * sizeof(Thunk);
+}
+
+// Pushes the control structure of a delta, first token deepest
+void CSEMachine::pushDelta(int deltaNum, TokenStack &controlStack){
+	const vector<Token>& delta = code->deltas[deltaNum];
+	for(unsigned int i=0;i<delta.size();i++){
+		controlStack.push(delta[i]);
+	}
+}
+
+// Binds a closure's parameter, or each name of a tuple parameter ("a,b,"),
+// appending the bindings to the environment record being built
+void CSEMachine::bindParameters(const Token& closure, Token& argument, Environment& env){
+	if(closure.isTuple == false){
+		bindings.push_back(Binding());
+		bindings.back().name = closure.lambdaParam;
+		bindings.back().value = std::move(argument);
+		env.bindingCount++;
+		if(profiler || tracer || heapProfiler)
+			nameClosure(bindings.back().value, closure.lambdaParam);
+	}else{
+		const string& params = closure.lambdaParam;
+		size_t start = 0;
+		for(unsigned int i=0;start < params.size();i++){
+			size_t comma = params.find(',', start);
+			if(comma == string::npos)
+				break;
+			if(comma != start){
+				bindings.push_back(Binding());
+				bindings.back().name.assign(params, start, comma - start);
+				bindings.back().value = argument.tuple[i];
+				env.bindingCount++;
+				if(profiler || tracer || heapProfiler)
+					nameClosure(bindings.back().value, bindings.back().name);
+			}
+			start = comma + 1;
+		}
+	}
+}
+
+// Applies a closure to the argument on top of the execution stack in a new
+// environment and returns the delta to run. A curried function f x y = E
+// compiles to lambdas whose bodies are just the next lambda; when the
+// control stack shows the call is saturated - the next tokens are the
+// gammas applying each returned lambda to the following argument - the
+// arguments are bound in the same environment and those gammas consumed,
+// so the call makes one frame instead of one per parameter. Partial
+// applications stop at the last gamma present and return the next lambda
+int CSEMachine::bindArguments(const Token& closure, int parent, TokenStack &controlStack, TokenStack &executionStack){
+	Environment env = { parent, (unsigned int)bindings.size(), 0, false };
+	bindParameters(closure, executionStack.top(), env);
+	executionStack.pop();
+	int body = closure.lambdaNum;
+	// A tuple parameter needs its argument forced, which the general path does
+	while(uncurryingEnabled && code->curriedDeltas[body] && controlStack.top().type == "gamma"
+			&& !(lazyEnabled && code->deltas[body][0].isTuple)){
+		STATS_ADD(stats, gammaApplications, 1);
+		controlStack.pop();
+		const Token& next = code->deltas[body][0];
+		bindParameters(next, executionStack.top(), env);
 		executionStack.pop();
-		int paramVal = atoi(firstToken.value.c_str());
-		paramVal = -paramVal;
-		Token newToken(intToString(paramVal), Lexer::INT);
-		executionStack.push(newToken);
-	}else if(currToken.type =="not"){
-		Token firstToken = executionStack.top();
+		body = next.lambdaNum;
+	}
+	env.frameLocal = code->frameLocalDeltas[body];
+	environments.push_back(env);
+	if(heapProfiler)
+		heapProfiler->allocate(HeapProfiler::ENVIRONMENT, sizeof(Environment) + env.bindingCount * sizeof(Binding));
+	return body;
+}
+
+// std::stack keeps its container protected; a derived accessor reads it
+struct TokenStackItems : TokenStack {
+	static const vector<Token>& of(const TokenStack& stack) { return stack.*&TokenStackItems::c; }
+};
+
+// Arguments an application of a builtin supplies, up to its arity: the one
+// on the execution stack, and one more for each gamma waiting on top of the
+// control stack to apply the result. A gamma that follows the one applying
+// the builtin always applies its result, since a rator is evaluated last
+static unsigned int suppliedArguments(const TokenStack& controlStack, unsigned int arity){
+	const vector<Token>& tokens = TokenStackItems::of(controlStack);
+	unsigned int supplied = 1;
+	while(supplied < arity && supplied <= tokens.size() && tokens[tokens.size() - supplied].type == "gamma")
+		supplied++;
+	return supplied;
+}
+
+// A builtin short of arguments becomes a partial application holding the ones supplied
+void CSEMachine::collectPartial(const Token& builtin, unsigned int supplied, TokenStack &controlStack, TokenStack &executionStack){
+	Token partial(builtin.value, PARTIAL);
+	for(unsigned int i=0;i<supplied;i++){
+		if(i > 0)
+			controlStack.pop();
+		partial.tuple.push_back(std::move(executionStack.top()));
 		executionStack.pop();
-		if(firstToken.value == "true"){
-			executionStack.push(Token("false","false"));
-		}else{
-			executionStack.push(Token("true","true"));
-		}
-	//}else if(currToken.type == LexicalAnalyzer::ID && isParamter(currToken)){
-	}else if(currToken.type == Lexer::ID && isParamter(currToken)){
-		string varName = currToken.value;
-		int temp = currEnv;
-		//cout <<  "Current env "<<temp<< endl;
-		pair<int,string> keyPair(temp,varName);
-		map<key_pair,Token>::iterator it = paramMap.find(keyPair);
-		while(paramMap.end() == it && temp>=0){
-			temp = envMap[temp];
-			keyPair.first = temp;
-			//cout << "Temp: "<<temp;
-			it = paramMap.find(keyPair);
-		}
-		if(paramMap.end() != it){
-			Token paramValToken = it->second;
-			//paramMap.erase(it);
-			executionStack.push(paramValToken);
+	}
+	executionStack.push(std::move(partial));
+}
+
+// Applies a partial application to the argument on the stack by replaying
+// the whole call: the arguments so far go back above it, with the builtin
+// and a gamma for every argument
+void CSEMachine::resumePartial(Token& partial, TokenStack &controlStack, TokenStack &executionStack){
+	vector<Token>& arguments = partial.tuple;
+	for(unsigned int i = arguments.size(); i > 0; i--){
+		executionStack.push(std::move(arguments[i - 1]));
+		controlStack.push(gammaToken);
+	}
+	executionStack.push(Token(partial.value, Lexer::ID));
+	controlStack.push(gammaToken);
+}
+
+// Live values for the heap profiler: everything bound in an environment and
+// everything on the execution stack. The control stack only holds copies of
+// the control structures, which the machine does not allocate at run time
+void CSEMachine::snapshotHeap(const TokenStack &executionStack){
+	heapProfiler->beginSnapshot();
+	for(unsigned int i=0;i<bindings.size();i++)
+		heapProfiler->addLive(bindings[i].value);
+	const vector<Token>& values = TokenStackItems::of(executionStack);
+	for(unsigned int i=0;i<values.size();i++)
+		heapProfiler->addLive(values[i]);
+	heapProfiler->endSnapshot(stepCount);
+}
+
+// Applies a closure - its lambda and the environment it links to - to the
+// argument on top of the execution stack
+void CSEMachine::enterClosure(const Token& closure, int parent, TokenStack &controlStack, TokenStack &executionStack){
+	if(profiler)
+		profiler->enter(closure.lambdaNum, closure.lambdaParam, closure.line, stepCount);
+	if(tracer)
+		tracer->enter(closure.lambdaNum, closure.lambdaParam, closure.line);
+	if(heapProfiler)
+		heapProfiler->enter(closure.lambdaNum, closure.lambdaParam, closure.line);
+	// Environments are numbered by their index in the table, captured ones included
+	envCounter = environments.size();
+	Token env("env",envCounter);
+	envStack.push(envCounter);
+	currEnv = envCounter;
+	int body = bindArguments(closure, parent, controlStack, executionStack);
+	controlStack.push(env);
+	executionStack.push(env);
+	pushDelta(body, controlStack);
+}
+
+// Applies the function on top of the execution stack to the value below it:
+// enters a closure, unrolls Y*, or runs a builtin
+void CSEMachine::applyGamma(TokenStack &controlStack, TokenStack &executionStack){
+	STATS_ADD(stats, gammaApplications, 1);
+	Token topExeToken(std::move(executionStack.top()));
+	executionStack.pop();
+	if(lazyEnabled && forceArguments(topExeToken, controlStack, executionStack))
+		return;
+	if(topExeToken.type == PARTIAL){
+		resumePartial(topExeToken, controlStack, executionStack);
+		return;
+	}
+	// Identifiers left unbound on the stack are the builtin functions
+	if(topExeToken.type == Lexer::ID){
+		unsigned int arity = builtinArity(topExeToken.value, executionStack.top());
+		unsigned int supplied = arity > 1 ? suppliedArguments(controlStack, arity) : 1;
+		if(supplied < arity){
+			collectPartial(topExeToken, supplied, controlStack, executionStack);
+			return;
 		}
-	}else if(currToken.type == "gamma"){
-		Token topExeToken = executionStack.top();
+	}
+	if(tracer && topExeToken.type == Lexer::ID)
+		tracer->builtin(topExeToken.value);
+	if(topExeToken.type == "lambdaClosure"){
+		enterClosure(topExeToken, topExeToken.lambdaEnv, controlStack, executionStack);
+	}else if(topExeToken.type == "YSTAR"){
+		//cout << "Inside Ystar "<< nextToken.type<<endl;
+		executionStack.top().type ="eta";
+	}else if(topExeToken.type == "eta"){
+		Token lambdaToken = topExeToken;
+		lambdaToken.type = "lambdaClosure";
+		executionStack.push(std::move(topExeToken));
+		executionStack.push(std::move(lambdaToken));
+		controlStack.push(gammaToken);
+		controlStack.push(gammaToken);
+	}else if(topExeToken.type == Lexer::ID && applySequenceBuiltin(topExeToken, controlStack, executionStack)){
+		// Range, Iterate, Take and Fold
+	}else if(topExeToken.type == Lexer::ID && applyVectorBuiltin(topExeToken, controlStack, executionStack)){
+		// Sum, Max, Min, Dot, Add and Mul
+	}else if(topExeToken.value == "Stern" || topExeToken.value == "stern"){
+		string& tokenValue = executionStack.top().value;
+		tokenValue = "'" + tokenValue.substr(2,tokenValue.size()-3) + "'";
+	}else if(topExeToken.value == "Stem" || topExeToken.value == "stem"){
+		string& tokenValue = executionStack.top().value;
+		tokenValue = "'" + tokenValue.substr(1,1) + "'";
+	}else if(topExeToken.value == "Conc" || topExeToken.value == "conc"){
+		Token firstToken(std::move(executionStack.top()));
 		executionStack.pop();
-		if(topExeToken.type == "lambdaClosure"){
-			Token env("env",++envCounter);
-			//cout<< "Parent: "<< topExeToken.lambdaEnv << " Env: "<< envCounter;
-			envMap[envCounter] = topExeToken.lambdaEnv;
-			envStack.push(envCounter);
-			currEnv = envCounter;
-			if(topExeToken.isTuple == false){
-				string paramName = topExeToken.lambdaParam;
-				Token paramToken = executionStack.top();
-				executionStack.pop();
-				//int paramValue = atoi(paramToken.value.c_str());
-				pair<int,string> keyPair(envCounter,paramName);
-				paramMap[keyPair] = paramToken;
-				//cout<< "Inside if"<<paramToken.type<<" Param name "<<paramName<< " Environment "<<envCounter<<endl;
+		Token& secondToken = executionStack.top();
+		//cout<< "Inside Concat 1 "<<firstToken.value << " 2 "<<secondToken.value<<endl;
+		string concatValue;
+		concatValue.reserve(firstToken.value.size() + secondToken.value.size() - 2);
+		concatValue.append(firstToken.value, 0, firstToken.value.size()-1);
+		concatValue.append(secondToken.value, 1, string::npos);
+		//cout <<"Concat value "<<concatValue<<endl;
+		secondToken = Token(concatValue,Lexer::STR);
+		if(heapProfiler)
+			secondToken.allocDelta = heapProfiler->allocate(HeapProfiler::STRING, HeapProfiler::valueBytes(secondToken));
+		//Removing extra gamma, which applyGamma has seen is there
+		controlStack.pop();
+	}else if(topExeToken.value == "ItoS" || topExeToken.value == "itos"){
+		Token& firstToken = executionStack.top();
+		firstToken.type = Lexer::STR;
+		firstToken.value = "'"+firstToken.value+"'";
+		if(heapProfiler)
+			firstToken.allocDelta = heapProfiler->allocate(HeapProfiler::STRING, HeapProfiler::valueBytes(firstToken));
+		//Removing extra gamma
+		//scontrolStack.pop();
+	}else if(topExeToken.value == "Print" || topExeToken.value == "print"){
+		printCalled = true;
+		//cout << "Inside print" << endl;
+		Token t(std::move(executionStack.top()));
+		executionStack.pop();
+		if(t.isTuple == false){
+			if(t.type== Lexer::STR){
+				string tempStr =unescape(t.value.substr(1,t.value.size()-2));
+				*output << tempStr;
+				if(tempStr[tempStr.size()-1] == '\n')
+					*output<<endl;
+				//cout << t.value.substr(1,t.value.size()-2);
+			}else if(t.type == "lambdaClosure"){
+				*output <<"[lambda closure: "<<t.lambdaParam<<": "<<t.lambdaNum<<"]";
+			}else if(t.type == SEQUENCE){
+				*output <<"[sequence: "<<t.value<<"]";
+			}else if(t.type == PARTIAL){
+				*output <<"[partial: "<<t.value<<"]";
+			}else if(t.type == MAP || (t.type == Lexer::ID && t.value == "MapEmpty")){
+				printMap(mapOperand(t, "Print"));
 			}else{
-				//cout << "Inside else"<<endl;
-				string tuple = topExeToken.lambdaParam;
-				vector<string> params = split(tuple,',');
-				Token valueTuple = executionStack.top();
-				//cout << "Value tuple: "<< valueTuple.type<< valueTuple.value <<endl;
-				executionStack.pop();
-				vector<Token> tupleVector = valueTuple.tuple;
-				//cout<< "Num of parameters "<< params.size() << " Num of values "<<tupleVector.size();
-				for(unsigned int i=0;i<params.size();i++){
-					if(params[i] != ""){
-						pair<int,string> keyPair(envCounter,params[i].c_str());
-						paramMap[keyPair] = tupleVector[i];
-					}
-					//cout<< "Inside for loop "<<endl;
-				}
-				//cout<< "Outside for"<<endl;
-				////cout << "Escaping else"<<paramMap["x"]<<paramMap["y"]<<endl;
-			}
-			controlStack.push(env);
-			executionStack.push(env);
-			int lambdaNum = topExeToken.lambdaNum;
-			vector<Token> delta = deltaMap[lambdaNum];
-			for(int i=0;i<delta.size();i++){
-				controlStack.push(delta[i]);
+				//cout<<t.value<<endl;
+				*output<<t.value;
 			}
-		}else if(topExeToken.type == "YSTAR"){
-			Token nextToken = executionStack.top();
-			//cout << "Inside Ystar "<< nextToken.type<<endl;
-			executionStack.pop();
-			nextToken.type ="eta";
-			executionStack.push(nextToken);
-		}else if(topExeToken.type == "eta"){
-			Token lambdaToken = topExeToken;
-			lambdaToken.type = "lambdaClosure";
-			executionStack.push(topExeToken);
-			executionStack.push(lambdaToken);
-			Token gammaToken("gamma","gamma");
-			controlStack.push(gammaToken);
-			controlStack.push(gammaToken);
-		}else if(topExeToken.value == "Stern" || topExeToken.value == "stern"){
-			Token stringToken = executionStack.top();
-			executionStack.pop();
-			string tokenValue = stringToken.value;
-			tokenValue = tokenValue.substr(2,tokenValue.size()-3);
-			tokenValue = "'"+tokenValue+"'";
-			stringToken.value = tokenValue;
-			executionStack.push(stringToken);
-		}else if(topExeToken.value == "Stem" || topExeToken.value == "stem"){
-			Token stringToken = executionStack.top();
-			executionStack.pop();
-			string tokenValue = stringToken.value;
-			tokenValue = tokenValue.substr(1,1);
-			tokenValue = "'"+tokenValue+"'";
-			stringToken.value = tokenValue;
-			executionStack.push(stringToken);
-		}else if(topExeToken.value == "Conc" || topExeToken.value == "conc"){
-			Token firstToken = executionStack.top();
-			executionStack.pop();
-			Token secondToken = executionStack.top();
-			executionStack.pop();
-			//cout<< "Inside Concat 1 "<<firstToken.value << " 2 "<<secondToken.value<<endl;
-			string concatValue = firstToken.value.substr(1,firstToken.value.size()-2)+secondToken.value.substr(1,secondToken.value.size()-2);
-			concatValue = "'"+concatValue+"'";
-			//cout <<"Concat value "<<concatValue<<endl;
-			Token newToken(concatValue,Lexer::STR);
-			executionStack.push(newToken);
-			//Removing extra gamma
-			controlStack.pop();
-		}else if(topExeToken.value == "ItoS" || topExeToken.value == "itos"){
-			Token firstToken = executionStack.top();
-			executionStack.pop();
-			firstToken.type = Lexer::STR;
-			firstToken.value = "'"+firstToken.value+"'";
-			executionStack.push(firstToken);
-			//Removing extra gamma
-			//scontrolStack.pop();
-		}else if(topExeToken.value == "Print" || topExeToken.value == "print"){
-			printCalled = true;
-			//cout << "Inside print" << endl;
-			Token t = executionStack.top();
-			executionStack.pop();
-			if(t.isTuple == false){
-				if(t.type== Lexer::STR){
-					string tempStr =unescape(t.value.substr(1,t.value.size()-2));
-					cout << tempStr;
-					if(tempStr[tempStr.size()-1] == '\n')
-						cout<<endl;
-					//cout << t.value.substr(1,t.value.size()-2);
-				}else if(t.type == "lambdaClosure"){
-					cout <<"[lambda closure: "<<t.lambdaParam<<": "<<t.lambdaNum<<"]";
+		}else{
+			const vector<Token>& tupleVector = t.tuple;
+			for(int i=0;i<tupleVector.size();i++){
+				if(i==0){
+					*output<<"(";
 				}else{
-					//cout<<t.value<<endl;
-					cout<<t.value;
+					*output<<", ";
 				}
-				Token dummyToken("dummy","dummy");
-				executionStack.push(dummyToken);
-			}else{
-				vector<Token> tupleVector = t.tuple;
-				for(int i=0;i<tupleVector.size();i++){
-					if(i==0){
-						cout<<"(";
-					}else{
-						cout<<", ";
-					}
-					if(tupleVector[i].type == Lexer::STR){
-						cout<< unescape(tupleVector[i].value.substr(1,tupleVector[i].value.size()-2));
-					}else if(tupleVector[i].isTuple == true ){
-						cout<<"Inside else if"<<endl;
-						vector<Token> innerTuple = tupleVector[i].tuple;
-						cout << "Size" << innerTuple.size()<<endl;
-						if(innerTuple.size() == 1){
-							if(innerTuple[0].type == Lexer::STR)
-								cout<< unescape(innerTuple[0].value.substr(1,innerTuple[0].value.size()-2));
-						}
-					}else{
-						cout << tupleVector[i].value;
-					}
-					if(i==tupleVector.size() -1){
-						cout<<")";
+				if(tupleVector[i].type == Lexer::STR){
+					*output<< unescape(tupleVector[i].value.substr(1,tupleVector[i].value.size()-2));
+				}else if(tupleVector[i].type == MAP || (tupleVector[i].type == Lexer::ID && tupleVector[i].value == "MapEmpty")){
+					printMap(mapOperand(tupleVector[i], "Print"));
+				}else if(tupleVector[i].isTuple == true ){
+					const vector<Token>& innerTuple = tupleVector[i].tuple;
+					if(innerTuple.size() == 1){
+						if(innerTuple[0].type == Lexer::STR)
+							*output<< unescape(innerTuple[0].value.substr(1,innerTuple[0].value.size()-2));
 					}
+				}else{
+					*output << tupleVector[i].value;
+				}
+				if(i==tupleVector.size() -1){
+					*output<<")";
 				}
-			}
-			//cout<< endl;
-		}else if(topExeToken.value == "Isinteger"){
-			Token t = executionStack.top();
-			executionStack.pop();
-			executionStack.push(t.type==Lexer::INT ? Token("true","true"):Token("false","false"));
-		}else if(topExeToken.value == "Istruthvalue"){
-			Token t = executionStack.top();
-			executionStack.pop();
-			executionStack.push(t.value=="true" || t.value=="false" ? Token("true","true"):Token("false","false"));
-		}else if(topExeToken.value == "Isstring"){
-			Token t = executionStack.top();
-			executionStack.pop();
-			executionStack.push(t.type==Lexer::STR ? Token("true","true"):Token("false","false"));
-		}else if(topExeToken.value == "Istuple"){
-			//cout<<"Inside is tuple"<<endl;
-			Token t = executionStack.top();
-			executionStack.pop();
-			executionStack.push(t.isTuple==true ? Token("true","true"):Token("false","false"));
-		}else if(topExeToken.value == "Isdummy"){
-			Token t = executionStack.top();
-			executionStack.pop();
-			executionStack.push(t.value=="dummy" ? Token("true","true"):Token("false","false"));
-		}else if(topExeToken.value == "Isfunction"){
-			Token t = executionStack.top();
-			executionStack.pop();
-			executionStack.push(t.type=="lambdaClosure" ? Token("true","true"):Token("false","false"));
-		}else if(topExeToken.value == "Order"){
-			//cout<<"Inside Order "<<endl;
-			Token t = executionStack.top();
-			executionStack.pop();
-			executionStack.push(Token(intToString(t.tuple.size()),Lexer::INT));
-		}else if(topExeToken.value == "Null"){
-			//cout<<"Inside Null "<<endl;
-			Token t = executionStack.top();
-			executionStack.pop();
-			executionStack.push((t.value == "nil") ? Token("true","true"):Token("false","false"));
-		}else if(topExeToken.isTuple == true){
-			Token t = executionStack.top();
-			executionStack.pop();
-			if(t.type == Lexer::INT){
-				int indx = atoi(t.value.c_str());
-				indx -=1;
-				executionStack.push(topExeToken.tuple[indx]);
 			}
 		}
-	}else if(currToken.type =="env"){
-		Token topToken = executionStack.top();
+		executionStack.push(dummyToken);
+		//cout<< endl;
+	}else if(topExeToken.value == "Isinteger"){
+		Token& t = executionStack.top();
+		t = truthToken(t.type==Lexer::INT);
+	}else if(topExeToken.value == "Istruthvalue"){
+		Token& t = executionStack.top();
+		t = truthToken(t.value=="true" || t.value=="false");
+	}else if(topExeToken.value == "Isstring"){
+		Token& t = executionStack.top();
+		t = truthToken(t.type==Lexer::STR);
+	}else if(topExeToken.value == "Istuple"){
+		//cout<<"Inside is tuple"<<endl;
+		Token& t = executionStack.top();
+		t = truthToken(t.isTuple==true);
+	}else if(topExeToken.value == "Isdummy"){
+		Token& t = executionStack.top();
+		t = truthToken(t.value=="dummy");
+	}else if(topExeToken.value == "Isfunction"){
+		Token& t = executionStack.top();
+		t = truthToken(t.type=="lambdaClosure");
+	}else if(topExeToken.value == "Order"){
+		//cout<<"Inside Order "<<endl;
+		Token& t = executionStack.top();
+		long long order = t.tuple.size();
+		if(t.type == SEQUENCE && t.value == "Range"){
+			order = max(0LL, wordArgument(t.tuple[1], "Order") - wordArgument(t.tuple[0], "Order") + 1);
+		}else if(t.type == SEQUENCE){
+			order = wordArgument(t.tuple[2], "Order");
+			if(order < 0)
+				throw runtime_error("Order of an unbounded sequence");
+		}
+		t = Token(intToString(order),Lexer::INT);
+	}else if(topExeToken.value == "Null"){
+		//cout<<"Inside Null "<<endl;
+		Token& t = executionStack.top();
+		t = truthToken(t.value == "nil");
+	}else if(topExeToken.type == Lexer::ID && applySortBuiltin(topExeToken, controlStack, executionStack)){
+		// Sort, SortBy, BinarySearch and Unique
+	}else if(topExeToken.type == Lexer::ID && applyMapBuiltin(topExeToken, controlStack, executionStack)){
+		// MapPut, MapGet, MapHas, MapSize and MapToTuple
+	}else if(topExeToken.isTuple == true){
+		Token t(std::move(executionStack.top()));
 		executionStack.pop();
+		long long index;
+		if(t.type != Lexer::INT || t.isTuple)
+			throw runtime_error("Tuple selection with a non-integer index " + t.value);
+		if(!BigInteger::toWord(t.value, index) || index < 1 || (unsigned long long)index > topExeToken.tuple.size())
+			throw runtime_error("Tuple index " + t.value + " out of range");
+		executionStack.push(topExeToken.tuple[index - 1]);
+	}
+}
+
+void CSEMachine::processCurrentToken(Token &currToken,TokenStack &controlStack, TokenStack &executionStack){
+	//cout<<"Control stack top: "<<currToken.type <<" Exe top: "<<executionStack.top().type<< endl;
+	//cout<<"Control stack top: "<<currToken.value <<" Exe top: "<<executionStack.top().value<< endl;
+	const Token* boundValue = NULL;
+	if(currToken.type == FUSED){
+		executeSuperinstruction(currToken, controlStack, executionStack);
+	}else if(currToken.type == Lexer::OPT){
+		Token firstToken(std::move(executionStack.top()));
+		executionStack.pop();
+		Token resultToken = applyOperator(firstToken, executionStack.top(), currToken);
+		executionStack.top() = std::move(resultToken);
+	}else if(currToken.type == "neg"){
+		Token& operand = executionStack.top();
+		long long paramVal;
+		if(BigInteger::toWord(operand.value, paramVal))
+			operand.value = intToString(-paramVal);
+		else
+			operand.value = (-BigInteger(operand.value)).toString();
+		operand.type = Lexer::INT;
+	}else if(currToken.type =="not"){
+		bool operandValue = executionStack.top().value == "true";
+		executionStack.top() = truthToken(!operandValue);
+	//}else if(currToken.type == LexicalAnalyzer::ID && isParamter(currToken)){
+	}else if(currToken.type == Lexer::ID && (boundValue = lookupVariable(currToken.value)) != NULL){
+		if(lazyEnabled && boundValue->type == THUNK)
+			forceThunk(boundValue->lambdaNum, controlStack, executionStack);
+		else
+			executionStack.push(*boundValue);
+	}else if(currToken.type == "gamma"){
+		applyGamma(controlStack, executionStack);
+	}else if(currToken.type =="env"){
+		if(profiler)
+			profiler->exit(stepCount);
+		if(tracer)
+			tracer->exit();
+		releaseFrame(currToken.envNum);
+		if(heapProfiler)
+			heapProfiler->exit();
+		Token topToken(std::move(executionStack.top()));
 		executionStack.pop();
-		executionStack.push(topToken);
+		executionStack.top() = std::move(topToken);
 		envStack.pop();
 		currEnv = envStack.top();
 	}else if(currToken.type == "beta"){
-		Token topToken = executionStack.top();
+		bool condition = executionStack.top().value == "true";
 		executionStack.pop();
-		vector<Token> delta;
-		if(topToken.value == "true"){
-			delta = deltaMap[currToken.betaIfDeltaNum];
-		}else{
-			delta = deltaMap[currToken.betaElseDeltaNum];
-		}
-		for(unsigned int i=0;i<delta.size();i++){
-			controlStack.push(delta[i]);
+		pushDelta(condition ? currToken.betaIfDeltaNum : currToken.betaElseDeltaNum, controlStack);
+	}else if(currToken.type == DELAY){
+		// Strictness heuristic: arithmetic on values is cheaper run now than delayed
+		if(code->primitiveOperands[currToken.lambdaNum] && operandsForced(currToken.lambdaNum)){
+			pushDelta(currToken.lambdaNum, controlStack);
+			return;
 		}
+		Thunk thunk = { currToken.lambdaNum, currEnv, false, Token() };
+		thunks.push_back(thunk);
+		executionStack.push(Token(THUNK, "", thunks.size() - 1));
+	}else if(currToken.type == SHARE){
+		if((boundValue = lookupVariable(currToken.value)) != NULL)
+			executionStack.push(*boundValue);
+		else
+			executionStack.push(Token(currToken.value, Lexer::ID));
+	}else if(currToken.type == MEMO){
+		Thunk& thunk = thunks[currToken.lambdaNum];
+		thunk.value = executionStack.top();
+		thunk.forced = true;
+		envStack.pop();
+		currEnv = envStack.top();
+	}else if(currToken.type == FOLD){
+		foldStep(currToken, controlStack, executionStack);
+	}else if(currToken.type == NEXT){
+		const Token& iterate = currToken.tuple[1];
+		executionStack.push(iterate.tuple[1]);
+		executionStack.push(iterate.tuple[0]);
+		currToken.type = ADVANCE;
+		controlStack.push(std::move(currToken));
+		controlStack.push(gammaToken);
+	}else if(currToken.type == ADVANCE){
+		currToken.tuple[1].tuple[1] = std::move(executionStack.top());
+		executionStack.pop();
+		foldStep(currToken, controlStack, executionStack);
+	}else if(currToken.type == MERGE){
+		bool rightFirst = executionStack.top().value == "true";
+		executionStack.pop();
+		vector<Token>& runs = currToken.tuple[1].tuple;
+		Token& cursor = currToken.tuple[rightFirst ? 6 : 5];
+		int index = atoi(cursor.value.c_str());
+		currToken.tuple[2].tuple.push_back(std::move(runs[index]));
+		cursor.value = intToString(index + 1);
+		mergeStep(currToken, controlStack, executionStack);
+	}else if(currToken.type == SORT_KEY){
+		currToken.tuple[2].tuple.push_back(std::move(executionStack.top()));
+		executionStack.pop();
+		sortKeyStep(currToken, controlStack, executionStack);
+	}else if(currToken.type == RESTORE){
+		for(unsigned int i=0;i<currToken.tuple.size();i++)
+			executionStack.push(std::move(currToken.tuple[i]));
 	}else if(currToken.value == "tau"){
 		int tauCount = currToken.tauCount;
 		//cout << "Tau count "<< tauCount<< endl;
 		string tuple="(";
 		vector<Token> tupleVector;
+		tupleVector.reserve(tauCount);
 		for(int i=0;i<tauCount;i++){
-			Token t = executionStack.top();
-			tupleVector.push_back(t);
-			executionStack.pop();
+			Token& t = executionStack.top();
 			if(i == tauCount -1)
 				tuple += t.value;
 			else
 				tuple += t.value +", ";
+			tupleVector.push_back(std::move(t));
+			executionStack.pop();
 		}
 		tuple +=")";
 		//cout<< "Tuple value: " <<tuple<<endl;
 		Token newToken(tuple,"tuple");
-		newToken.tuple = tupleVector;
+		newToken.tuple = std::move(tupleVector);
 		newToken.isTuple = true;
-		executionStack.push(newToken);
+		if(heapProfiler)
+			newToken.allocDelta = heapProfiler->allocate(HeapProfiler::TUPLE, HeapProfiler::valueBytes(newToken));
+		executionStack.push(std::move(newToken));
 	}else if(currToken.value == "nil"){
 		currToken.isTuple = true;
-		executionStack.push(currToken);
+		executionStack.push(std::move(currToken));
 	}else if(currToken.value == "aug"){
 		//cout <<"Inside aug "<<endl;
-		Token tuple = executionStack.top();
-		executionStack.pop();
-		Token toAdd = executionStack.top();
+		Token tuple(std::move(executionStack.top()));
 		executionStack.pop();
+		Token& toAdd = executionStack.top();
 		if(tuple.value == "nil"){
 			//Token newToken("("+toAdd.value+")","tuple");
 			Token newToken(toAdd.value,"tuple");
 			newToken.isTuple = true;
 			newToken.tuple = vector<Token>();
-			newToken.tuple.push_back(toAdd);
-			executionStack.push(newToken);
+			newToken.tuple.push_back(std::move(toAdd));
+			if(heapProfiler)
+				newToken.allocDelta = heapProfiler->allocate(HeapProfiler::TUPLE, HeapProfiler::valueBytes(newToken));
+			toAdd = std::move(newToken);
 		}else{
-			tuple.tuple.push_back(toAdd);
-			executionStack.push(tuple);
+			// The grown tuple stays with the site that created it; the growth is charged here
+			tuple.tuple.push_back(std::move(toAdd));
+			tuple.packed.reset();
+			if(heapProfiler)
+				heapProfiler->allocate(HeapProfiler::TUPLE, sizeof(Token));
+			toAdd = std::move(tuple);
 		}
 	}else if(currToken.type == "lambdaClosure"){
 		//cout<< "Inside lambdaclosure env set"<<endl;
-		currToken.lambdaEnv = currEnv;
-		executionStack.push(currToken);
+		if(flatClosuresEnabled && code->flatClosures[currToken.lambdaNum])
+			currToken.lambdaEnv = captureEnvironment(currToken.lambdaNum);
+		else
+			currToken.lambdaEnv = currEnv;
+		executionStack.push(std::move(currToken));
 	}else{
-		executionStack.push(currToken);
+		if(heapProfiler && currToken.type == Lexer::STR)
+			currToken.allocDelta = heapProfiler->allocate(HeapProfiler::STRING, HeapProfiler::valueBytes(currToken));
+		executionStack.push(std::move(currToken));
 	}
 }
 
 
-Token CSEMachine::applyOperator(Token firstToken, Token secondToken, Token currToken){
-	string tokenVal = currToken.value;
+Token CSEMachine::applyOperator(const Token& firstToken, const Token& secondToken, const Token& currToken){
+	const string& tokenVal = currToken.value;
 	//cout <<"Operator: "<< currToken.value<< endl;
 	if(firstToken.type == Lexer::INT){
-		int firstVal = atoi(firstToken.value.c_str());
-		int secondVal = atoi(secondToken.value.c_str());
-		//cout<< firstVal << " "<< secondVal<< endl;
-		int resultVal = 0;
+		long long firstVal, secondVal, resultVal;
+		if(BigInteger::toWord(firstToken.value, firstVal) && BigInteger::toWord(secondToken.value, secondVal)){
+			// Fast path: machine words, as long as the result does not overflow
+			if(tokenVal == "*"){
+				if(!__builtin_mul_overflow(firstVal, secondVal, &resultVal))
+					return Token(intToString(resultVal),firstToken.type);
+			}else if(tokenVal == "+"){
+				if(!__builtin_add_overflow(firstVal, secondVal, &resultVal))
+					return Token(intToString(resultVal),firstToken.type);
+			}else if(tokenVal == "-"){
+				if(!__builtin_sub_overflow(firstVal, secondVal, &resultVal))
+					return Token(intToString(resultVal),firstToken.type);
+			}else if(tokenVal == "/"){
+				if(secondVal == 0)
+					throw runtime_error("Division by zero");
+				return Token(intToString(firstVal/secondVal),firstToken.type);
+			}else if(tokenVal == "**"){
+				if(powerFitsWord(firstVal, secondVal, resultVal))
+					return Token(intToString(resultVal),firstToken.type);
+			}else if(tokenVal == "gr"){
+				return truthToken(firstVal > secondVal);
+			}else if(tokenVal == "ls"){
+				//cout << "Inside less than" <<endl;
+				return truthToken(firstVal < secondVal);
+			}else if(tokenVal == "ge"){
+				return truthToken(firstVal >= secondVal);
+			}else if(tokenVal == "le"){
+				return truthToken(firstVal <= secondVal);
+			}else if(tokenVal == "eq"){
+				return truthToken(firstVal == secondVal);
+			}else if(tokenVal == "ne"){
+				return truthToken(firstVal != secondVal);
+			}
+		}
+		// Promoted: an operand is too long for a word, or the result overflowed one
+		BigInteger first(firstToken.value);
+		BigInteger second(secondToken.value);
 		if(tokenVal == "*"){
-			resultVal = firstVal*secondVal;
-			return Token(intToString(resultVal),firstToken.type);
+			return Token((first * second).toString(),firstToken.type);
 		}else if(tokenVal == "+"){
-			resultVal = firstVal+secondVal;
-			return Token(intToString(resultVal),firstToken.type);
+			return Token((first + second).toString(),firstToken.type);
 		}else if(tokenVal == "-"){
-			resultVal = firstVal-secondVal;
-			return Token(intToString(resultVal),firstToken.type);
+			return Token((first - second).toString(),firstToken.type);
 		}else if(tokenVal == "/"){
-			resultVal = firstVal/secondVal;
-			return Token(intToString(resultVal),firstToken.type);
+			if(second.isZero())
+				throw runtime_error("Division by zero");
+			return Token((first / second).toString(),firstToken.type);
 		}else if(tokenVal == "**"){
-			resultVal = pow(firstVal,secondVal);
-			return Token(intToString(resultVal),firstToken.type);
-		}else if(tokenVal == "gr"){
-			return (firstVal > secondVal ? Token("true","true"):Token("false","false"));
+			return Token(bigPower(first, second).toString(),firstToken.type);
+		}
+		int order = BigInteger::compare(first, second);
+		if(tokenVal == "gr"){
+			return truthToken(order > 0);
 		}else if(tokenVal == "ls"){
-			//cout << "Inside less than" <<endl;
-			return (firstVal < secondVal ? Token("true","true"):Token("false","false"));
+			return truthToken(order < 0);
 		}else if(tokenVal == "ge"){
-			return (firstVal >= secondVal ? Token("true","true"):Token("false","false"));
+			return truthToken(order >= 0);
 		}else if(tokenVal == "le"){
-			return (firstVal <= secondVal ? Token("true","true"):Token("false","false"));
+			return truthToken(order <= 0);
 		}else if(tokenVal == "eq"){
-			return (firstVal == secondVal ? Token("true","true"):Token("false","false"));
+			return truthToken(order == 0);
 		}else if(tokenVal == "ne"){
-			return (firstVal != secondVal ? Token("true","true"):Token("false","false"));
+			return truthToken(order != 0);
 		}
 	}else if(firstToken.type == Lexer::STR){ // String operators
 		if(tokenVal == "eq"){
-			return (firstToken.value == secondToken.value ? Token("true","true"):Token("false","false"));
+			return truthToken(firstToken.value == secondToken.value);
 		}else if(tokenVal == "ne"){
-			return (firstToken.value != secondToken.value ? Token("true","true"):Token("false","false"));
+			return truthToken(firstToken.value != secondToken.value);
 		}
 	}else if(firstToken.type == "true" || firstToken.type == "false"){ // Boolean operators
 		//cout<< "Inside boolean field"<<endl;
 		if(tokenVal == "or"){
 			//cout << "Inside or "<<firstToken.type << " "<<secondToken.type<<endl;
-			return ((firstToken.type=="true" || secondToken.type=="true")? Token("true","true"): Token("false","false"));
+			return truthToken(firstToken.type=="true" || secondToken.type=="true");
 		}else if(tokenVal == "&"){
-			return ((firstToken.type=="true" && secondToken.type=="true")? Token("true","true"): Token("false","false"));
+			return truthToken(firstToken.type=="true" && secondToken.type=="true");
 		}else if(tokenVal == "eq"){
-			return ((firstToken.type==secondToken.type)? Token("true","true"): Token("false","false"));
+			return truthToken(firstToken.type==secondToken.type);
 		}else if(tokenVal == "ne"){
-			return ((firstToken.type != secondToken.type)? Token("true","true"): Token("false","false"));
+			return truthToken(firstToken.type != secondToken.type);
 		}
 	}
 	return Token("","");
@@ -428,73 +852,1352 @@ void CSEMachine::createControlStructures(TreeNode* root){
 	//if not then put the token in current delta.
 	//if no more preorder elements start a new tree with elements present in the stack, insert the delta in the stack with the
 	//Appropriate number.
+	// Fused sequences look variables up without forcing them
+	if(lazyEnabled)
+		superinstructionsEnabled = false;
+	shared_ptr<ControlStructures> built = make_shared<ControlStructures>();
+	built->lazy = lazyEnabled;
+	compiling = built.get();
+	if(!strictBooleans)
+		collectBoundNames(root);
 	pendingDeltaQueue.push(root);
 	while(!pendingDeltaQueue.empty()){
 		vector<Token> currentDelta;
 		TreeNode* currStartNode = pendingDeltaQueue.front();
 		pendingDeltaQueue.pop();
-		preOrderTraversal(currStartNode, currentDelta);
-		deltaMap[currDeltaNum++] = currentDelta;
+		if(currStartNode != NULL){
+			if(truthDeltas.count(currDeltaNum) != 0){
+				currentDelta.push_back(Token("not","not"));
+				currentDelta.push_back(Token("not","not"));
+			}
+			preOrderTraversal(currStartNode, currentDelta);
+		}else{
+			currentDelta.push_back(pendingConstants.front());
+			pendingConstants.pop();
+		}
+		if(superinstructionsEnabled)
+			fuseSuperinstructions(currentDelta);
+		// Deltas are numbered in the order they are queued, so delta n lands at index n
+		built->deltas.push_back(std::move(currentDelta));
+		currDeltaNum++;
+	}
+	// Deltas that only return another lambda, the inner levels of curried functions
+	vector<vector<Token> >& deltas = built->deltas;
+	built->curriedDeltas.resize(deltas.size());
+	for(unsigned int i=0;i<deltas.size();i++)
+		built->curriedDeltas[i] = deltas[i].size() == 1 && deltas[i][0].type == "lambdaClosure";
+	analyzeFreeVariables();
+	analyzeEscapes();
+	if(superinstructionsEnabled && knownCallsEnabled)
+		resolveKnownCalls();
+	compiling = NULL;
+	code = built;
+}
+
+// Names a closure binds: its parameter, or each name of a tuple parameter ("a,b,")
+static vector<string> parameterNames(const Token& closure){
+	vector<string> names;
+	if(closure.isTuple == false){
+		names.push_back(closure.lambdaParam);
+		return names;
+	}
+	const string& params = closure.lambdaParam;
+	size_t start = 0;
+	size_t comma;
+	while((comma = params.find(',', start)) != string::npos){
+		if(comma != start)
+			names.push_back(params.substr(start, comma - start));
+		start = comma + 1;
+	}
+	return names;
+}
+
+// Free variables of a closure: those of its delta (sorted) minus its parameters
+static vector<string> closureFreeVariables(const Token& closure, const vector<string>& deltaFree){
+	vector<string> params = parameterNames(closure);
+	sort(params.begin(), params.end());
+	vector<string> names;
+	set_difference(deltaFree.begin(), deltaFree.end(), params.begin(), params.end(), back_inserter(names));
+	return names;
+}
+
+// Identifiers a control token uses: its own, those of the branches a beta
+// selects and of the tokens fused into a superinstruction, and the free
+// variables of a closure it creates
+void CSEMachine::collectFreeVariables(const Token& token, const vector<vector<string> >& deltaFree, vector<string>& names){
+	if(token.type == Lexer::ID){
+		names.push_back(token.value);
+	}else if(token.type == "beta"){
+		names.insert(names.end(), deltaFree[token.betaIfDeltaNum].begin(), deltaFree[token.betaIfDeltaNum].end());
+		names.insert(names.end(), deltaFree[token.betaElseDeltaNum].begin(), deltaFree[token.betaElseDeltaNum].end());
+	}else if(token.type == DELAY){
+		names.insert(names.end(), deltaFree[token.lambdaNum].begin(), deltaFree[token.lambdaNum].end());
+	}else if(token.type == SHARE){
+		names.push_back(token.value);
+	}else if(token.type == "lambdaClosure"){
+		vector<string> closureFree = closureFreeVariables(token, deltaFree[token.lambdaNum]);
+		names.insert(names.end(), closureFree.begin(), closureFree.end());
+	}else if(token.type == FUSED){
+		const vector<Token>& fused = compiling->superinstructions[token.fusedIndex].tokens;
+		for(unsigned int i=0;i<fused.size();i++)
+			collectFreeVariables(fused[i], deltaFree, names);
+	}
+}
+
+// Free-variable analysis for flat closures. A lambda that is applied where
+// it is created - the function of a let or where - keeps linking to the
+// environment it was created in. Any other lambda may outlive that
+// environment, so its closure gets an environment of its own holding copies
+// of just its free variables, captured when it is created; lookups from its
+// body then never walk further than that record
+void CSEMachine::analyzeFreeVariables(){
+	const vector<vector<Token> >& deltas = compiling->deltas;
+	vector<vector<string> > deltaFree(deltas.size());
+	compiling->flatClosures.assign(deltas.size(), false);
+	compiling->capturedNames.assign(deltas.size(), vector<string>());
+	// Branches and lambda bodies are numbered after the delta they appear in,
+	// so walking backwards sees every delta after those it contains
+	for(int d = deltas.size() - 1; d >= 0; d--){
+		vector<string> names;
+		for(unsigned int i=0;i<deltas[d].size();i++)
+			collectFreeVariables(deltas[d][i], deltaFree, names);
+		sort(names.begin(), names.end());
+		names.erase(unique(names.begin(), names.end()), names.end());
+		deltaFree[d].swap(names);
+	}
+	for(unsigned int d=0;d<deltas.size();d++){
+		for(unsigned int i=0;i<deltas[d].size();i++){
+			const Token& token = deltas[d][i];
+			if(token.type != "lambdaClosure" || (i > 0 && deltas[d][i-1].type == "gamma"))
+				continue;
+			compiling->flatClosures[token.lambdaNum] = true;
+			compiling->capturedNames[token.lambdaNum] = closureFreeVariables(token, deltaFree[token.lambdaNum]);
+		}
+	}
+}
+
+// Environment of a flat closure: the current values of its free variables.
+// Names that are not bound - the builtins - are left to fail lookup as before
+int CSEMachine::captureEnvironment(int lambdaNum){
+	const vector<string>& names = code->capturedNames[lambdaNum];
+	if(names.empty())
+		return 0;
+	Environment env = { 0, (unsigned int)bindings.size(), 0, false };
+	for(unsigned int i=0;i<names.size();i++){
+		const Token* boundValue = lookupVariable(names[i]);
+		if(boundValue == NULL)
+			continue;
+		Token value(*boundValue);       // Copied first, growing bindings may move it
+		bindings.push_back(Binding());
+		bindings.back().name = names[i];
+		bindings.back().value = std::move(value);
+		env.bindingCount++;
+	}
+	environments.push_back(env);
+	if(heapProfiler)
+		heapProfiler->allocate(HeapProfiler::ENVIRONMENT, sizeof(Environment) + env.bindingCount * sizeof(Binding));
+	return environments.size() - 1;
+}
+
+// Whether the token at i leaves the running frame unreferenced once the call
+// returns. The only closures that may keep it are those created there, and a
+// lambda applied where it is created is consumed by that gamma; a thunk, like
+// a closure, keeps the frame it is created in. Branches run in the frame that
+// selects them
+bool CSEMachine::keepsFrameLocal(const vector<Token>& delta, unsigned int i) const{
+	const Token& token = delta[i];
+	if(token.type == "lambdaClosure")
+		return i > 0 && delta[i-1].type == "gamma";
+	if(token.type == DELAY)
+		return false;
+	if(token.type == "beta")
+		return compiling->frameLocalDeltas[token.betaIfDeltaNum] && compiling->frameLocalDeltas[token.betaElseDeltaNum];
+	if(token.type == FUSED){
+		const vector<Token>& fused = compiling->superinstructions[token.fusedIndex].tokens;
+		for(unsigned int j=0;j<fused.size();j++){
+			if(!keepsFrameLocal(fused, j))
+				return false;
+		}
 	}
-	for(int j=0;j<deltaMap.size();j++){
-		//cout <<"Size for map "<<j<<" "<<deltaMap[j].size()<<endl;
-		for(int i=0;i<deltaMap[j].size();i++){
-				//cout << deltaMap[j][i].type<<",";
+	return true;
+}
+
+// Escape analysis for frame reclamation: a delta whose frame no closure can
+// capture - whether returned, stored in a tuple or bound - gets frames that
+// are released when the call returns
+void CSEMachine::analyzeEscapes(){
+	const vector<vector<Token> >& deltas = compiling->deltas;
+	compiling->frameLocalDeltas.assign(deltas.size(), true);
+	for(int d = deltas.size() - 1; d >= 0; d--){
+		for(unsigned int i=0;i<deltas[d].size();i++){
+			if(!keepsFrameLocal(deltas[d], i)){
+				compiling->frameLocalDeltas[d] = false;
+				break;
 			}
-		//cout << endl;
+		}
 	}
+}
+
+// Environments and bindings are allocated at the top of their tables, so
+// frames behave as a stack: a frame-local environment popped while it is
+// still the newest record is cut off with its bindings, and the space is
+// reused by the next call. Records created during the call that outlive it -
+// captured environments, frames of calls that returned closures - sit above
+// the frame and keep it, which also protects everything they reach
+void CSEMachine::releaseFrame(int envNum){
+	if(envNum + 1 != (int)environments.size() || !environments[envNum].frameLocal)
+		return;
+	const Environment& env = environments[envNum];
+	if(heapProfiler)
+		heapProfiler->release(HeapProfiler::ENVIRONMENT, sizeof(Environment) + env.bindingCount * sizeof(Binding));
+	bindings.erase(bindings.begin() + env.firstBinding, bindings.end());
+	environments.pop_back();
+	reclaimedEnvironments++;
+}
 
+// Operands that are values already, with nothing to delay
+static bool isValueOperand(const Token& operand){
+	const string& type = operand.type;
+	return type == "lambda" || type == Lexer::INT || type == Lexer::STR || type == "YSTAR"
+		|| type == "true" || type == "false" || type == "nil" || type == "dummy";
 }
 
+// Expressions whose value is always true or false
+static bool givesTruthValue(const Token& root){
+	const string& type = root.type;
+	const string& value = root.value;
+	return type == "not" || type == "true" || type == "false"
+		|| (type == Lexer::OPT && (value == "or" || value == "&" || value == "gr" || value == "ge"
+			|| value == "ls" || value == "le" || value == "eq" || value == "ne"));
+}
 
+// Flattens one delta in pre-order. Pending siblings and children are kept on an
+// explicit stack (right pushed before left) so deep trees cannot overflow the
+// C++ stack; lambda bodies and conditional branches go to pendingDeltaQueue.
 void CSEMachine::preOrderTraversal(TreeNode* root, vector<Token> &currentDelta){
-	if(root->value.type == "lambda"){
-		if(root->left->value.value != ","){
-			Token lambdaClosure("lambdaClosure",root->left->value.value, ++deltaCounter);
-			currentDelta.push_back(lambdaClosure);
+	vector<TreeNode*> pendingNodes;
+	pendingNodes.push_back(root);
+	while(!pendingNodes.empty()){
+		TreeNode* node = pendingNodes.back();
+		pendingNodes.pop_back();
+		// NULL marks the node under it as a delayed operand
+		if(node == NULL){
+			delayOperand(pendingNodes.back(), currentDelta);
+			pendingNodes.pop_back();
+			continue;
+		}
+		const Token& nodeToken = arena->token(node);
+		if(nodeToken.type == "lambda"){
+			const Token& paramToken = arena->token(node->left);
+			if(paramToken.value != ","){
+				Token lambdaClosure("lambdaClosure",paramToken.value, ++deltaCounter);
+				lambdaClosure.line = paramToken.line;
+				currentDelta.push_back(lambdaClosure);
+			}else{
+				TreeNode* commaChild = node->left->left;
+				string tuple;
+				while(commaChild != NULL){
+					tuple += arena->token(commaChild).value + ",";
+					commaChild = commaChild->right;
+				}
+				Token lambdaClosure("lambdaClosure",tuple, ++deltaCounter);
+				lambdaClosure.isTuple = true;
+				lambdaClosure.line = arena->token(node->left->left).line;
+				currentDelta.push_back(lambdaClosure);
+			}
+			pendingDeltaQueue.push(node->left->right);
+			if(node->right != NULL)
+				pendingNodes.push_back(node->right);
+		}else if(nodeToken.value == "->"){
+			Token betaToken("beta",deltaCounter+1,deltaCounter+2);
+			currentDelta.push_back(betaToken);
+			pendingDeltaQueue.push(node->left->right);
+			pendingDeltaQueue.push(node->left->right->right);
+
+			node->left->right->right = NULL;
+			node->left->right = NULL;
+			deltaCounter +=2;
+			if(node->right != NULL)
+				pendingNodes.push_back(node->right);
+			pendingNodes.push_back(node->left);
+		}else if(lazyEnabled && nodeToken.type == "gamma" && !isValueOperand(arena->token(node->left->right))){
+			// The operand runs when its binding is first looked up, after the operator
+			TreeNode* rator = node->left;
+			currentDelta.push_back(nodeToken);
+			if(node->right != NULL)
+				pendingNodes.push_back(node->right);
+			pendingNodes.push_back(rator->right);
+			pendingNodes.push_back(NULL);
+			rator->right = NULL;
+			pendingNodes.push_back(rator);
+		}else if(!strictBooleans && nodeToken.type == Lexer::OPT && (nodeToken.value == "or" || nodeToken.value == "&")
+				&& !mayHaveEffects(node->left->right)){
+			// Short circuit: A or B runs as A -> true | B, and A & B as A -> B | false.
+			// Like the operators, they give truth values: B's delta ends in not not
+			// unless B gives one anyway
+			TreeNode* rightOperand = node->left->right;
+			Token betaToken("beta",deltaCounter+1,deltaCounter+2);
+			currentDelta.push_back(betaToken);
+			if(!givesTruthValue(arena->token(rightOperand)))
+				truthDeltas.insert(nodeToken.value == "or" ? deltaCounter+2 : deltaCounter+1);
+			if(nodeToken.value == "or"){
+				pendingDeltaQueue.push(NULL);
+				pendingConstants.push(trueToken);
+				pendingDeltaQueue.push(rightOperand);
+			}else{
+				pendingDeltaQueue.push(rightOperand);
+				pendingDeltaQueue.push(NULL);
+				pendingConstants.push(falseToken);
+			}
+
+			node->left->right = NULL;
+			deltaCounter +=2;
+			if(node->right != NULL)
+				pendingNodes.push_back(node->right);
+			pendingNodes.push_back(node->left);
+		}else{
+			currentDelta.push_back(nodeToken);
+			if(node->right != NULL)
+				pendingNodes.push_back(node->right);
+			if(node->left != NULL)
+				pendingNodes.push_back(node->left);
+		}
+	}
+}
+
+// An argument passed by need. A variable shares its binding, thunk or
+// value; anything else becomes a delta of its own, run as a thunk
+void CSEMachine::delayOperand(TreeNode* operand, vector<Token> &currentDelta){
+	const Token& operandToken = arena->token(operand);
+	if(operandToken.type == Lexer::ID){
+		Token share(operandToken.value, SHARE);
+		share.line = operandToken.line;
+		currentDelta.push_back(share);
+		return;
+	}
+	currentDelta.push_back(Token(DELAY, "", ++deltaCounter));
+	pendingDeltaQueue.push(operand);
+	compiling->primitiveOperands.resize(deltaCounter + 1);
+	compiling->primitiveOperands[deltaCounter] = isPrimitiveOperand(operand);
+}
+
+// Whether an operand only applies operators to literals and variables, and
+// so always finishes without effects once its variables have values.
+// Division is left out, since it can fail
+bool CSEMachine::isPrimitiveOperand(TreeNode* operand) const{
+	vector<TreeNode*> pendingNodes;
+	pendingNodes.push_back(operand);
+	while(!pendingNodes.empty()){
+		TreeNode* node = pendingNodes.back();
+		pendingNodes.pop_back();
+		const Token& nodeToken = arena->token(node);
+		bool primitive = nodeToken.type == Lexer::OPT ? nodeToken.value != "/" && nodeToken.value != "@"
+			: nodeToken.type == Lexer::ID || nodeToken.type == Lexer::INT || nodeToken.type == Lexer::STR
+			|| nodeToken.type == "neg" || nodeToken.type == "not" || nodeToken.type == "true" || nodeToken.type == "false";
+		if(!primitive)
+			return false;
+		if(node != operand && node->right != NULL)
+			pendingNodes.push_back(node->right);
+		if(node->left != NULL)
+			pendingNodes.push_back(node->left);
+	}
+	return true;
+}
+
+// Whether every variable a delta reads is bound to a value or a forced thunk
+bool CSEMachine::operandsForced(int deltaNum) const{
+	const vector<Token>& delta = code->deltas[deltaNum];
+	for(unsigned int i=0;i<delta.size();i++){
+		if(delta[i].type != Lexer::ID)
+			continue;
+		const Token* boundValue = lookupVariable(delta[i].value);
+		if(boundValue == NULL || (boundValue->type == THUNK && !thunks[boundValue->lambdaNum].forced))
+			return false;
+	}
+	return true;
+}
+
+// Builtins that never print and never call back into the program; every other
+// function a short-circuited operand applies might
+static bool isPureBuiltin(const string& name){
+	static const unordered_set<string> pure = {
+		"Stem", "stem", "Stern", "stern", "Conc", "conc", "ItoS", "itos", "Order", "Null",
+		"Isinteger", "Istruthvalue", "Isstring", "Istuple", "Isdummy", "Isfunction",
+		"Range", "Sum", "Max", "Min", "Dot", "Add", "Mul", "Unique", "BinarySearch",
+		"MapPut", "MapGet", "MapHas", "MapSize", "MapToTuple"
+	};
+	return pure.count(name) != 0;
+}
+
+// Names bound anywhere in the tree, by a lambda's variable or variable tuple
+void CSEMachine::collectBoundNames(TreeNode* root){
+	vector<TreeNode*> pendingNodes;
+	pendingNodes.push_back(root);
+	while(!pendingNodes.empty()){
+		TreeNode* node = pendingNodes.back();
+		pendingNodes.pop_back();
+		if(arena->token(node).type == "lambda"){
+			const Token& paramToken = arena->token(node->left);
+			if(paramToken.value != ","){
+				boundNames.insert(paramToken.value);
+			}else{
+				for(TreeNode* commaChild = node->left->left; commaChild != NULL; commaChild = commaChild->right)
+					boundNames.insert(arena->token(commaChild).value);
+			}
+		}
+		if(node->right != NULL)
+			pendingNodes.push_back(node->right);
+		if(node->left != NULL)
+			pendingNodes.push_back(node->left);
+	}
+}
+
+// Whether running an operand - the node and everything below it - might print.
+// It might if it names Print, or applies anything but a pure builtin the
+// program leaves unbound: a variable could hold a function that prints.
+// Lambdas and curried applications are fine, as their bodies and operators
+// are in the operand too
+bool CSEMachine::mayHaveEffects(TreeNode* operand) const{
+	vector<TreeNode*> pendingNodes;
+	pendingNodes.push_back(operand);
+	while(!pendingNodes.empty()){
+		TreeNode* node = pendingNodes.back();
+		pendingNodes.pop_back();
+		const Token& nodeToken = arena->token(node);
+		if(nodeToken.type == Lexer::ID && (nodeToken.value == "Print" || nodeToken.value == "print"))
+			return true;
+		if(nodeToken.type == "gamma"){
+			const Token& rator = arena->token(node->left);
+			if(rator.type == Lexer::ID ? !isPureBuiltin(rator.value) || boundNames.count(rator.value) != 0
+					: rator.type != "lambda" && rator.type != "gamma")
+				return true;
+		}
+		if(node != operand && node->right != NULL)
+			pendingNodes.push_back(node->right);
+		if(node->left != NULL)
+			pendingNodes.push_back(node->left);
+	}
+	return false;
+}
+
+
+static bool hasType(const vector<Token>& delta, unsigned int i, const string& type){
+	return i < delta.size() && delta[i].type == type;
+}
+
+// Binary operators; @ keeps its three operands and is never fused
+static bool isBinaryOperator(const vector<Token>& delta, unsigned int i){
+	return hasType(delta, i, Lexer::OPT) && delta[i].value != "@";
+}
+
+// Rewrites a delta, replacing each fusable sequence - leftmost and longest
+// first - by a superinstruction token. Operands follow their operator in
+// pre-order, so every sequence below is an operator or application together
+// with operands that are leaves of the tree
+void CSEMachine::fuseSuperinstructions(vector<Token> &delta){
+	vector<Token> fused;
+	fused.reserve(delta.size());
+	unsigned int i = 0;
+	while(i < delta.size()){
+		Superinstruction::Kind kind;
+		unsigned int length = 0;
+		if(delta[i].type == "beta" && isBinaryOperator(delta, i+1)){
+			bool varInt = hasType(delta, i+2, Lexer::ID) && hasType(delta, i+3, Lexer::INT);
+			kind = varInt ? Superinstruction::BRANCH_VAR_INT : Superinstruction::BRANCH_OP;
+			length = varInt ? 4 : 2;
+		}else if(isBinaryOperator(delta, i) && hasType(delta, i+1, Lexer::ID) && hasType(delta, i+2, Lexer::INT)){
+			kind = Superinstruction::OP_VAR_INT;
+			length = 3;
+		}else if(delta[i].type == "gamma" && hasType(delta, i+1, Lexer::ID)){
+			bool varVar = hasType(delta, i+2, Lexer::ID);
+			kind = varVar ? Superinstruction::APPLY_VAR_VAR : Superinstruction::APPLY_VAR;
+			length = varVar ? 3 : 2;
+		}
+		if(length == 0){
+			fused.push_back(std::move(delta[i]));
+			i++;
+			continue;
+		}
+		Superinstruction entry;
+		entry.kind = kind;
+		entry.knownCall = false;
+		entry.recursiveCallee = false;
+		for(unsigned int j = i; j < i + length; j++)
+			entry.tokens.push_back(std::move(delta[j]));
+		Token fusedToken(superinstructionNames[kind], FUSED);
+		fusedToken.fusedIndex = compiling->superinstructions.size();
+		compiling->superinstructions.push_back(std::move(entry));
+		fused.push_back(std::move(fusedToken));
+		i += length;
+	}
+	delta.swap(fused);
+}
+
+// What an identifier is statically known to be bound to: a lambda, or the Y*
+// wrapper of a rec definition
+struct KnownBinding {
+	const Token* lambda;
+	bool recursive;
+};
+typedef map<string, KnownBinding> KnownScope;
+
+// Binding-time analysis for known calls. A let or where compiles to
+// "gamma lambda(x) lambda(y)" and a rec to "gamma lambda(f) gamma Y*
+// lambda(f)" whose body is the function's lambda; in the scope of x or f -
+// the delta of the first lambda, the Y* wrapper for f itself, and the deltas
+// nested in them until a parameter shadows the name - the callee of an
+// application of the name is known. Deltas are numbered after the delta
+// they appear in, so each scope is complete before it is used
+void CSEMachine::resolveKnownCalls(){
+	const vector<vector<Token> >& deltas = compiling->deltas;
+	const vector<bool>& curriedDeltas = compiling->curriedDeltas;
+	vector<KnownScope> scopes(deltas.size());
+	for(unsigned int d=0;d<deltas.size();d++){
+		const vector<Token>& delta = deltas[d];
+		for(unsigned int i=0;i<delta.size();i++){
+			const Token& token = delta[i];
+			if(token.type == "beta"){
+				scopes[token.betaIfDeltaNum] = scopes[d];
+				scopes[token.betaElseDeltaNum] = scopes[d];
+			}else if(token.type == "lambdaClosure"){
+				KnownScope& scope = scopes[token.lambdaNum];
+				scope = scopes[d];
+				vector<string> params = parameterNames(token);
+				for(unsigned int p=0;p<params.size();p++)
+					scope.erase(params[p]);
+				if(token.isTuple)
+					continue;
+				bool rator = i > 0 && delta[i-1].type == "gamma";
+				if(rator && hasType(delta, i+1, "lambdaClosure")){
+					KnownBinding binding = { &delta[i+1], false };
+					scope[token.lambdaParam] = binding;
+				}else if(rator && hasType(delta, i+2, "YSTAR") && hasType(delta, i+3, "lambdaClosure")
+						&& curriedDeltas[delta[i+3].lambdaNum]){
+					KnownBinding binding = { &delta[i+3], true };
+					scope[token.lambdaParam] = binding;
+				}else if(i > 0 && delta[i-1].type == "YSTAR" && curriedDeltas[token.lambdaNum]){
+					KnownBinding binding = { &token, true };
+					scope[token.lambdaParam] = binding;
+				}
+			}else if(token.type == FUSED){
+				Superinstruction& entry = compiling->superinstructions[token.fusedIndex];
+				if(entry.kind == Superinstruction::BRANCH_OP || entry.kind == Superinstruction::BRANCH_VAR_INT){
+					scopes[entry.tokens[0].betaIfDeltaNum] = scopes[d];
+					scopes[entry.tokens[0].betaElseDeltaNum] = scopes[d];
+				}else if(entry.kind == Superinstruction::APPLY_VAR || entry.kind == Superinstruction::APPLY_VAR_VAR){
+					KnownScope::const_iterator known = scopes[d].find(entry.tokens[1].value);
+					if(known == scopes[d].end())
+						continue;
+					entry.knownCall = true;
+					entry.recursiveCallee = known->second.recursive;
+					entry.callee = *known->second.lambda;
+				}
+			}
+		}
+	}
+}
+
+
+// An identifier's value, or - when unbound, as for the builtins - the identifier itself
+void CSEMachine::pushVariable(const Token &identifier, TokenStack &executionStack){
+	const Token* boundValue = lookupVariable(identifier.value);
+	executionStack.push(boundValue != NULL ? *boundValue : identifier);
+}
+
+// One step doing the work of a fused sequence; the sequence runs right to
+// left, operands first, exactly as its tokens would one by one
+void CSEMachine::executeSuperinstruction(const Token &fusedToken, TokenStack &controlStack, TokenStack &executionStack){
+	const Superinstruction& fused = code->superinstructions[fusedToken.fusedIndex];
+	const vector<Token>& tokens = fused.tokens;
+	switch(fused.kind){
+	case Superinstruction::OP_VAR_INT:{
+		const Token* boundValue = lookupVariable(tokens[1].value);
+		executionStack.push(applyOperator(boundValue != NULL ? *boundValue : tokens[1], tokens[2], tokens[0]));
+		break;
+	}
+	case Superinstruction::BRANCH_OP:{
+		Token firstToken(std::move(executionStack.top()));
+		executionStack.pop();
+		bool condition = applyOperator(firstToken, executionStack.top(), tokens[1]).value == "true";
+		executionStack.pop();
+		pushDelta(condition ? tokens[0].betaIfDeltaNum : tokens[0].betaElseDeltaNum, controlStack);
+		break;
+	}
+	case Superinstruction::BRANCH_VAR_INT:{
+		const Token* boundValue = lookupVariable(tokens[2].value);
+		bool condition = applyOperator(boundValue != NULL ? *boundValue : tokens[2], tokens[3], tokens[1]).value == "true";
+		pushDelta(condition ? tokens[0].betaIfDeltaNum : tokens[0].betaElseDeltaNum, controlStack);
+		break;
+	}
+	case Superinstruction::APPLY_VAR_VAR:
+		pushVariable(tokens[2], executionStack);
+		// fall through
+	case Superinstruction::APPLY_VAR:
+		if(fused.knownCall && applyKnownCall(fused, controlStack, executionStack))
+			break;
+		pushVariable(tokens[1], executionStack);
+		applyGamma(controlStack, executionStack);
+		break;
+	}
+}
+
+// Direct entry of a known call: the callee's lambda is known, so only the
+// environment is read from the binding, in place, and the closure is never
+// copied to the stack or dispatched on. A rec function is entered through
+// its Y* wrapper the way applying the eta would, without the two steps of
+// unrolling it. Returns false, leaving the call to the general path, when the
+// binding does not hold the closure the analysis expected
+bool CSEMachine::applyKnownCall(const Superinstruction& call, TokenStack &controlStack, TokenStack &executionStack){
+	const Token* boundValue = lookupVariable(call.tokens[1].value);
+	if(boundValue == NULL || boundValue->lambdaNum != call.callee.lambdaNum)
+		return false;
+	if(call.recursiveCallee){
+		if(boundValue->type != "eta")
+			return false;
+		executionStack.push(*boundValue);
+		controlStack.push(gammaToken);
+	}else if(boundValue->type != "lambdaClosure"){
+		return false;
+	}
+	STATS_ADD(stats, gammaApplications, 1);
+	STATS_ADD(stats, knownCalls, 1);
+	enterClosure(call.callee, boundValue->lambdaEnv, controlStack, executionStack);
+	return true;
+}
+
+// Pushes a thunk's value, running its delta first if it has not been forced;
+// the memo below the delta keeps the value for every copy of the thunk
+void CSEMachine::forceThunk(int thunkNum, TokenStack &controlStack, TokenStack &executionStack){
+	const Thunk& thunk = thunks[thunkNum];
+	if(thunk.forced){
+		executionStack.push(thunk.value);
+		return;
+	}
+	controlStack.push(Token(MEMO, "", thunkNum));
+	envStack.push(thunk.env);
+	currEnv = thunk.env;
+	pushDelta(thunk.deltaNum, controlStack);
+}
+
+// Lazy evaluation keeps the arguments of closures as they are, but builtins,
+// tuple selection and tuple parameters are strict: the arguments supplied -
+// up to two for Conc - are forced first. Returns true when one had to be run; the values
+// above it and the operator are set aside to be restored, and the
+// application is retried once the thunk's value is in place
+bool CSEMachine::forceArguments(Token& rator, TokenStack &controlStack, TokenStack &executionStack){
+	// A partial application's arguments are forced when its builtin is called again
+	if(rator.type == "eta" || rator.type == "YSTAR" || rator.type == PARTIAL || (rator.type == "lambdaClosure" && !rator.isTuple))
+		return false;
+	const string& name = rator.value;
+	unsigned int count = suppliedArguments(controlStack, builtinArity(name, executionStack.top()));
+	vector<Token> above;
+	for(unsigned int i=0;i<count;i++){
+		Token& argument = executionStack.top();
+		if(argument.type == THUNK && thunks[argument.lambdaNum].forced)
+			argument = thunks[argument.lambdaNum].value;
+		if(argument.type == THUNK){
+			Token restore(RESTORE, 0);
+			restore.tuple.assign(make_move_iterator(above.rbegin()), make_move_iterator(above.rend()));
+			restore.tuple.push_back(std::move(rator));
+			int thunkNum = argument.lambdaNum;
+			executionStack.pop();
+			controlStack.push(gammaToken);
+			controlStack.push(std::move(restore));
+			forceThunk(thunkNum, controlStack, executionStack);
+			return true;
+		}
+		// Sort takes a tuple to sort by natural order, or a comparator and then the tuple
+		if(i == 0 && name == "Sort" && argument.type == "lambdaClosure")
+			count = suppliedArguments(controlStack, 2);
+		if(i + 1 < count){
+			above.push_back(std::move(argument));
+			executionStack.pop();
+		}
+	}
+	while(!above.empty()){
+		executionStack.push(std::move(above.back()));
+		above.pop_back();
+	}
+	return false;
+}
+
+// The sequence builtins. Like Conc they take all their arguments at once,
+// consuming the gammas that apply the partial results; applyGamma calls
+// them only once those gammas are there. Returns false for any other builtin
+bool CSEMachine::applySequenceBuiltin(const Token& builtin, TokenStack &controlStack, TokenStack &executionStack){
+	const string& name = builtin.value;
+	if(name != "Range" && name != "Iterate" && name != "Take" && name != "Fold")
+		return false;
+	Token first(std::move(executionStack.top()));
+	executionStack.pop();
+	controlStack.pop();
+	if(name == "Range"){
+		wordArgument(first, name);
+		wordArgument(executionStack.top(), name);
+		Token range("Range", SEQUENCE);
+		range.tuple.push_back(std::move(first));
+		range.tuple.push_back(std::move(executionStack.top()));
+		executionStack.top() = std::move(range);
+	}else if(name == "Iterate"){
+		Token iterate("Iterate", SEQUENCE);
+		iterate.tuple.push_back(std::move(first));
+		iterate.tuple.push_back(std::move(executionStack.top()));
+		iterate.tuple.push_back(Token("-1", Lexer::INT));
+		executionStack.top() = std::move(iterate);
+	}else if(name == "Take"){
+		long long count = max(0LL, wordArgument(first, name));
+		Token& sequence = executionStack.top();
+		if(sequence.type == SEQUENCE && sequence.value == "Range"){
+			long long from = wordArgument(sequence.tuple[0], name);
+			if(wordArgument(sequence.tuple[1], name) - from >= count)
+				sequence.tuple[1].value = intToString(from + count - 1);
+		}else if(sequence.type == SEQUENCE){
+			long long limit = wordArgument(sequence.tuple[2], name);
+			if(limit < 0 || limit > count)
+				sequence.tuple[2].value = intToString(count);
+		}else if(!sequence.isTuple){
+			throw runtime_error("Take applied to a non-sequence");
+		}else if(count < (long long)sequence.tuple.size()){
+			sequence.tuple.resize(count);
+			sequence.packed.reset();
+			sequence.value = count == 0 ? "nil" : "tuple";
+		}
+	}else{
+		Token accumulator(std::move(executionStack.top()));
+		executionStack.pop();
+		controlStack.pop();
+		Token& sequence = executionStack.top();
+		if(sequence.type != SEQUENCE && !sequence.isTuple)
+			throw runtime_error("Fold applied to a non-sequence");
+		if(sequence.isTuple){
+			Token elements("Elements", SEQUENCE);
+			elements.tuple.push_back(std::move(sequence));
+			elements.tuple.push_back(Token("0", Lexer::INT));
+			sequence = std::move(elements);
+		}
+		int operatorDelta = sequence.value == "Iterate" ? -1 : primitiveFoldOperator(first);
+		if(operatorDelta >= 0){
+			sequence = foldPrimitive(operatorDelta, first.lambdaParam, std::move(accumulator), sequence);
+			return true;
+		}
+		Token step("", FOLD);
+		step.tuple.push_back(std::move(first));
+		step.tuple.push_back(std::move(sequence));
+		executionStack.top() = std::move(accumulator);
+		foldStep(step, controlStack, executionStack);
+	}
+	return true;
+}
+
+// One element of a fold: while the sequence has one left, the function is
+// applied to the accumulator and the element by the two gammas pushed here,
+// with the fold - or for Iterate the step computing the next element - under
+// them to continue once the new accumulator is on the stack
+void CSEMachine::foldStep(Token& step, TokenStack &controlStack, TokenStack &executionStack){
+	Token& cursor = step.tuple[1];
+	Token element;
+	if(cursor.value == "Range"){
+		long long from = wordArgument(cursor.tuple[0], "Fold");
+		long long to = wordArgument(cursor.tuple[1], "Fold");
+		if(from > to)
+			return;
+		element = cursor.tuple[0];
+		// The last element empties the range from the top, so from never passes the largest bound
+		if(from == to)
+			cursor.tuple[1].value = intToString(to - 1);
+		else
+			cursor.tuple[0].value = intToString(from + 1);
+		step.type = FOLD;
+	}else if(cursor.value == "Elements"){
+		unsigned long long index = wordArgument(cursor.tuple[1], "Fold");
+		if(index >= cursor.tuple[0].tuple.size())
+			return;
+		element = cursor.tuple[0].tuple[index];
+		cursor.tuple[1].value = intToString(index + 1);
+		step.type = FOLD;
+	}else{
+		long long limit = wordArgument(cursor.tuple[2], "Fold");
+		if(limit == 0)
+			return;
+		element = cursor.tuple[1];
+		if(limit > 0)
+			cursor.tuple[2].value = intToString(limit - 1);
+		step.type = NEXT;
+	}
+	Token function = step.tuple[0];
+	Token accumulator(std::move(executionStack.top()));
+	executionStack.pop();
+	executionStack.push(std::move(element));
+	executionStack.push(std::move(accumulator));
+	executionStack.push(std::move(function));
+	// The last element of a bounded Iterate needs no successor
+	if(!(step.type == NEXT && cursor.tuple[2].value == "0"))
+		controlStack.push(std::move(step));
+	controlStack.push(gammaToken);
+	controlStack.push(gammaToken);
+}
+
+// The delta of the body of a fold function of the form fn a. fn b. x op y,
+// where x and y are each a or b; -1 for any other function
+int CSEMachine::primitiveFoldOperator(const Token& function) const{
+	if(function.type != "lambdaClosure" || function.isTuple)
+		return -1;
+	const vector<Token>& outer = code->deltas[function.lambdaNum];
+	if(outer.size() != 1 || outer[0].type != "lambdaClosure" || outer[0].isTuple)
+		return -1;
+	const vector<Token>& body = code->deltas[outer[0].lambdaNum];
+	const string& accumulator = function.lambdaParam;
+	const string& element = outer[0].lambdaParam;
+	if(accumulator == element || body.size() != 3 || body[0].type != Lexer::OPT || body[0].value == "@")
+		return -1;
+	for(unsigned int i=1;i<3;i++){
+		if(body[i].type != Lexer::ID || (body[i].value != accumulator && body[i].value != element))
+			return -1;
+	}
+	return outer[0].lambdaNum;
+}
+
+// Folds a range or a tuple with such a function in a native loop: the
+// operator is applied directly, with no closure applications
+Token CSEMachine::foldPrimitive(int operatorDelta, const string& accumulatorName, Token accumulator, const Token& sequence){
+	const vector<Token>& body = code->deltas[operatorDelta];
+	bool accumulatorFirst = body[1].value == accumulatorName;
+	bool accumulatorSecond = body[2].value == accumulatorName;
+	const string& op = body[0].value;
+	long long from = sequence.value == "Range" ? wordArgument(sequence.tuple[0], "Fold") : 0;
+	long long to = sequence.value == "Range" ? wordArgument(sequence.tuple[1], "Fold") : 0;
+	long long value;
+	if(sequence.value == "Range" && accumulator.type == Lexer::INT && (op == "+" || op == "-" || op == "*")
+			&& BigInteger::toWord(accumulator.value, value)){
+		// Integer arithmetic stays in a machine word until it would overflow,
+		// and goes on through applyOperator from the element that did
+		char symbol = op[0];
+		bool overflow = false;
+		for(; from <= to; from++){
+			long long first = accumulatorFirst ? value : from;
+			long long second = accumulatorSecond ? value : from;
+			long long next;
+			overflow = symbol == '+' ? __builtin_add_overflow(first, second, &next)
+					: symbol == '-' ? __builtin_sub_overflow(first, second, &next)
+					: __builtin_mul_overflow(first, second, &next);
+			if(overflow)
+				break;
+			value = next;
+		}
+		accumulator = Token(intToString(value), Lexer::INT);
+		if(!overflow)
+			return accumulator;
+	}
+	if(sequence.value == "Range"){
+		for(long long i = from; i <= to; i++){
+			Token element(intToString(i), Lexer::INT);
+			accumulator = applyOperator(accumulatorFirst ? accumulator : element, accumulatorSecond ? accumulator : element, body[0]);
+		}
+	}else{
+		const vector<Token>& elements = sequence.tuple[0].tuple;
+		for(unsigned int i=0;i<elements.size();i++)
+			accumulator = applyOperator(accumulatorFirst ? accumulator : elements[i], accumulatorSecond ? accumulator : elements[i], body[0]);
+	}
+	return accumulator;
+}
+
+// The vector builtins over all-integer tuples. Sum, Max and Min reduce one
+// tuple, Dot two of the same length; Add and Mul combine two element by
+// element into a new tuple. They run on the tuples' packed form, so two
+// arguments are taken at once as Conc does. Returns false for any other builtin
+bool CSEMachine::applyVectorBuiltin(const Token& builtin, TokenStack &controlStack, TokenStack &executionStack){
+	const string& name = builtin.value;
+	bool binary = name == "Dot" || name == "Add" || name == "Mul";
+	if(!binary && name != "Sum" && name != "Max" && name != "Min")
+		return false;
+	if(!binary){
+		Token& tuple = executionStack.top();
+		const vector<int64_t>* values = packTuple(tuple, name);
+		if(tuple.tuple.empty() && name != "Sum")
+			throw runtime_error(name + " of an empty tuple");
+		int64_t result;
+		if(values == NULL || (name == "Sum" && !PackedInts::sum(values->data(), values->size(), result))){
+			tuple = combineUnpacked(name, tuple.tuple, tuple.tuple);
+			return true;
+		}
+		if(name != "Sum")
+			result = name == "Max" ? PackedInts::max(values->data(), values->size())
+					: PackedInts::min(values->data(), values->size());
+		tuple = Token(intToString(result), Lexer::INT);
+		return true;
+	}
+	Token first(std::move(executionStack.top()));
+	executionStack.pop();
+	controlStack.pop();
+	Token& second = executionStack.top();
+	const vector<int64_t>* a = packTuple(first, name);
+	const vector<int64_t>* b = packTuple(second, name);
+	if(first.tuple.size() != second.tuple.size())
+		throw runtime_error(name + " of tuples of different lengths");
+	if(a != NULL && b != NULL){
+		if(name == "Dot"){
+			int64_t result;
+			if(PackedInts::dot(a->data(), b->data(), a->size(), result)){
+				second = Token(intToString(result), Lexer::INT);
+				return true;
+			}
 		}else{
-			TreeNode* commaChild = root->left->left;
-			string tuple;
-			while(commaChild != NULL){
-				tuple += commaChild->value.value + ",";
-				commaChild = commaChild->right;
+			vector<int64_t> result(a->size());
+			if(name == "Add" ? PackedInts::add(a->data(), b->data(), result.data(), a->size())
+					: PackedInts::multiply(a->data(), b->data(), result.data(), a->size())){
+				second = integerTuple(result);
+				return true;
 			}
-			Token lambdaClosure("lambdaClosure",tuple, ++deltaCounter);
-			lambdaClosure.isTuple = true;
-			currentDelta.push_back(lambdaClosure);
-		}
-		//cout<<currentDelta.size()<<endl;
-		pendingDeltaQueue.push(root->left->right);
-		if(root->right !=NULL)
-					preOrderTraversal(root->right,currentDelta);
-	}else if(root->value.value == "->"){
-		Token betaToken("beta",deltaCounter+1,deltaCounter+2);
-		currentDelta.push_back(betaToken);
-		pendingDeltaQueue.push(root->left->right);
-		pendingDeltaQueue.push(root->left->right->right);
-
-		root->left->right->right = NULL;
-		root->left->right = NULL; //Not sure about this
-		deltaCounter +=2;
-		if(root->left != NULL)
-				preOrderTraversal(root->left,currentDelta);
-		if(root->right !=NULL)
-				preOrderTraversal(root->right,currentDelta);
+		}
+	}
+	// A bignum element, or a result overflowing a machine word
+	second = combineUnpacked(name, first.tuple, second.tuple);
+	return true;
+}
+
+// The packed form of a tuple argument, built on first use and kept with
+// the token. Every element must be an integer; NULL when one is a bignum,
+// and the builtin then works on the elements themselves
+const vector<int64_t>* CSEMachine::packTuple(Token& tuple, const string& builtin){
+	if(!tuple.isTuple)
+		throw runtime_error(builtin + " applied to a non-tuple");
+	if(!tuple.packed){
+		std::shared_ptr<vector<int64_t> > values = std::make_shared<vector<int64_t> >();
+		values->reserve(tuple.tuple.size());
+		bool fits = true;
+		for(unsigned int i=0;i<tuple.tuple.size();i++){
+			if(tuple.tuple[i].type != Lexer::INT)
+				throw runtime_error(builtin + " of a tuple with a non-integer element");
+			long long value;
+			fits = fits && BigInteger::toWord(tuple.tuple[i].value, value);
+			if(fits)
+				values->push_back(value);
+		}
+		if(!fits)
+			return NULL;
+		tuple.packed = values;
+	}
+	return tuple.packed.get();
+}
+
+// The vector builtins element by element through applyOperator, whose
+// arithmetic is exact at any size; b is ignored by Sum, Max and Min
+Token CSEMachine::combineUnpacked(const string& name, const vector<Token>& a, const vector<Token>& b){
+	Token plus("+", Lexer::OPT);
+	Token times("*", Lexer::OPT);
+	if(name == "Max" || name == "Min"){
+		Token beats(name == "Max" ? "gr" : "ls", Lexer::OPT);
+		const Token* best = &a[0];
+		for(unsigned int i=1;i<a.size();i++){
+			if(applyOperator(a[i], *best, beats).value == "true")
+				best = &a[i];
+		}
+		return *best;
+	}
+	if(name == "Sum" || name == "Dot"){
+		Token total("0", Lexer::INT);
+		for(unsigned int i=0;i<a.size();i++)
+			total = applyOperator(total, name == "Sum" ? a[i] : applyOperator(a[i], b[i], times), plus);
+		return total;
+	}
+	Token result(a.empty() ? "nil" : "tuple", "tuple");
+	result.isTuple = true;
+	result.tuple.reserve(a.size());
+	for(unsigned int i=0;i<a.size();i++)
+		result.tuple.push_back(applyOperator(a[i], b[i], name == "Add" ? plus : times));
+	if(heapProfiler)
+		result.allocDelta = heapProfiler->allocate(HeapProfiler::TUPLE, HeapProfiler::valueBytes(result));
+	return result;
+}
+
+// A tuple of the given machine words. It keeps them as its packed form, so
+// a vector builtin applied to it next need not pack it again
+Token CSEMachine::integerTuple(const vector<int64_t>& values){
+	Token result(values.empty() ? "nil" : "tuple", "tuple");
+	result.isTuple = true;
+	result.tuple.reserve(values.size());
+	for(unsigned int i=0;i<values.size();i++)
+		result.tuple.push_back(Token(intToString(values[i]), Lexer::INT));
+	result.packed = std::make_shared<const vector<int64_t> >(values);
+	if(heapProfiler)
+		result.allocDelta = heapProfiler->allocate(HeapProfiler::TUPLE, HeapProfiler::valueBytes(result));
+	return result;
+}
+
+// Order of two integers or two strings; strings compare by their text,
+// without the quotes they are kept in
+static int compareNatural(const Token& a, const Token& b){
+	if(a.type == Lexer::INT)
+		return BigInteger::compareDecimal(a.value, b.value);
+	return a.value.compare(1, a.value.size() - 2, b.value, 1, b.value.size() - 2);
+}
+
+// Equal as Unique sees it: same type and value, integers by number;
+// tuples and closures are never equal
+static bool sameValue(const Token& a, const Token& b){
+	if(a.isTuple || b.isTuple || a.type != b.type || a.type == "lambdaClosure")
+		return false;
+	return a.type == Lexer::INT ? BigInteger::compareDecimal(a.value, b.value) == 0 : a.value == b.value;
+}
+
+// The sort and search builtins. Sort orders a tuple of integers or of
+// strings, or - given a comparator c first, true when its first argument
+// goes before its second - any tuple. SortBy k orders a tuple by the keys k
+// gives its elements. Both are stable. BinarySearch t x is the index of the
+// first element of sorted t equal to x, 0 when there is none, and Unique
+// drops elements equal to the one before them. Returns false for any other
+// builtin
+bool CSEMachine::applySortBuiltin(const Token& builtin, TokenStack &controlStack, TokenStack &executionStack){
+	const string& name = builtin.value;
+	if(name != "Sort" && name != "SortBy" && name != "BinarySearch" && name != "Unique")
+		return false;
+	Token& top = executionStack.top();
+	if(name == "Unique"){
+		if(!top.isTuple)
+			throw runtime_error("Unique applied to a non-tuple");
+		vector<Token>& elements = top.tuple;
+		unsigned int kept = 0;
+		for(unsigned int i=0;i<elements.size();i++){
+			if(kept > 0 && sameValue(elements[kept - 1], elements[i]))
+				continue;
+			if(kept != i)
+				elements[kept] = std::move(elements[i]);
+			kept++;
+		}
+		if(kept < elements.size()){
+			elements.resize(kept);
+			top.packed.reset();
+		}
+		return true;
+	}
+	if(name == "Sort" && top.isTuple && top.type != "lambdaClosure"){
+		vector<unsigned int> order = naturalOrder(top.tuple, name);
+		std::shared_ptr<const vector<int64_t> > packed = top.packed;
+		top = permutedTuple(top.tuple, order);
+		if(packed){
+			std::shared_ptr<vector<int64_t> > sorted = std::make_shared<vector<int64_t> >(order.size());
+			for(unsigned int i=0;i<order.size();i++)
+				(*sorted)[i] = (*packed)[order[i]];
+			top.packed = sorted;
+		}
+		return true;
+	}
+	Token first(std::move(top));
+	executionStack.pop();
+	controlStack.pop();
+	Token& second = executionStack.top();
+	if(name == "BinarySearch"){
+		if(!first.isTuple)
+			throw runtime_error("BinarySearch applied to a non-tuple");
+		const vector<Token>& elements = first.tuple;
+		for(unsigned int i=0;i<elements.size();i++){
+			if(elements[i].type != second.type || (second.type != Lexer::INT && second.type != Lexer::STR))
+				throw runtime_error("BinarySearch of values with no natural order");
+		}
+		unsigned int low = 0;
+		unsigned int high = elements.size();
+		while(low < high){
+			unsigned int middle = low + (high - low) / 2;
+			if(compareNatural(elements[middle], second) < 0)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+		bool found = low < elements.size() && compareNatural(elements[low], second) == 0;
+		second = Token(intToString(found ? low + 1 : 0), Lexer::INT);
+		return true;
+	}
+	if(first.type != "lambdaClosure")
+		throw runtime_error(name + " needs a function and a tuple");
+	if(!second.isTuple)
+		throw runtime_error(name + " applied to a non-tuple");
+	Token state("", name == "Sort" ? MERGE : SORT_KEY);
+	state.tuple.push_back(std::move(first));
+	state.tuple.push_back(std::move(second));
+	executionStack.pop();
+	if(name == "Sort"){
+		Token merged("tuple", "tuple");
+		merged.isTuple = true;
+		state.tuple.push_back(std::move(merged));
+		for(int i=0;i<4;i++)
+			state.tuple.push_back(Token(i == 0 || i == 3 ? "1" : "0", Lexer::INT));
+		mergeStep(state, controlStack, executionStack);
+	}else{
+		Token keys("tuple", "tuple");
+		keys.isTuple = true;
+		state.tuple.push_back(std::move(keys));
+		sortKeyStep(state, controlStack, executionStack);
+	}
+	return true;
+}
+
+// Merges the current pair of runs until the comparator has to decide
+// between their heads, which the gammas pushed here ask it with the right
+// head first; then the merge token takes the winner. When the runs are
+// exhausted the next pair is merged, and once a pass is through the runs
+// double. Ties keep the left element, so the sort is stable
+void CSEMachine::mergeStep(Token& state, TokenStack &controlStack, TokenStack &executionStack){
+	vector<Token>& source = state.tuple[1].tuple;
+	vector<Token>& target = state.tuple[2].tuple;
+	unsigned int size = source.size();
+	unsigned int width = atoi(state.tuple[3].value.c_str());
+	unsigned int low = atoi(state.tuple[4].value.c_str());
+	unsigned int left = atoi(state.tuple[5].value.c_str());
+	unsigned int right = atoi(state.tuple[6].value.c_str());
+	while(width < size){
+		unsigned int middle = min(low + width, size);
+		unsigned int high = min(low + 2 * width, size);
+		if(left < middle && right < high){
+			state.tuple[3].value = intToString(width);
+			state.tuple[4].value = intToString(low);
+			state.tuple[5].value = intToString(left);
+			state.tuple[6].value = intToString(right);
+			executionStack.push(source[left]);
+			executionStack.push(source[right]);
+			executionStack.push(state.tuple[0]);
+			controlStack.push(std::move(state));
+			controlStack.push(gammaToken);
+			controlStack.push(gammaToken);
+			return;
+		}
+		while(left < middle)
+			target.push_back(std::move(source[left++]));
+		while(right < high)
+			target.push_back(std::move(source[right++]));
+		low = high;
+		if(low >= size){
+			source.swap(target);
+			target.clear();
+			width *= 2;
+			low = 0;
+		}
+		left = low;
+		right = min(low + width, size);
+	}
+	Token sorted(std::move(state.tuple[1]));
+	sorted.value = size == 0 ? "nil" : "tuple";
+	sorted.packed.reset();
+	executionStack.push(std::move(sorted));
+}
+
+// Applies SortBy's key function to the next element, with the sort key
+// token under the gamma to take the key; once every element has one the
+// tuple is sorted by them natively
+void CSEMachine::sortKeyStep(Token& state, TokenStack &controlStack, TokenStack &executionStack){
+	vector<Token>& elements = state.tuple[1].tuple;
+	const vector<Token>& keys = state.tuple[2].tuple;
+	if(keys.size() < elements.size()){
+		executionStack.push(elements[keys.size()]);
+		executionStack.push(state.tuple[0]);
+		controlStack.push(std::move(state));
+		controlStack.push(gammaToken);
+		return;
+	}
+	vector<unsigned int> order = naturalOrder(keys, "SortBy");
+	executionStack.push(permutedTuple(elements, order));
+}
+
+// Stable sorting permutation of integer or string keys, all of one type
+vector<unsigned int> CSEMachine::naturalOrder(const vector<Token>& keys, const string& builtin){
+	vector<unsigned int> order(keys.size());
+	for(unsigned int i=0;i<order.size();i++)
+		order[i] = i;
+	if(keys.empty())
+		return order;
+	const string& type = keys[0].type;
+	for(unsigned int i=0;i<keys.size();i++){
+		if(keys[i].isTuple || keys[i].type != type || (type != Lexer::INT && type != Lexer::STR))
+			throw runtime_error(builtin + " of values with no natural order");
+	}
+	// Integers that all fit a machine word are compared as words
+	vector<long long> values(type == Lexer::INT ? keys.size() : 0);
+	bool words = type == Lexer::INT;
+	for(unsigned int i=0;i<values.size() && words;i++)
+		words = BigInteger::toWord(keys[i].value, values[i]);
+	if(words){
+		parallelStableSort(order, [&values](unsigned int a, unsigned int b) { return values[a] < values[b]; });
 	}else{
-		currentDelta.push_back(root->value);
-		if(root->left != NULL)
-				preOrderTraversal(root->left,currentDelta);
-		if(root->right !=NULL)
-					preOrderTraversal(root->right,currentDelta);
+		parallelStableSort(order, [&keys](unsigned int a, unsigned int b) { return compareNatural(keys[a], keys[b]) < 0; });
 	}
+	return order;
+}
 
+// A new tuple of the elements in the given order, moved out of elements
+Token CSEMachine::permutedTuple(vector<Token>& elements, const vector<unsigned int>& order){
+	Token result(order.empty() ? "nil" : "tuple", "tuple");
+	result.isTuple = true;
+	result.tuple.reserve(order.size());
+	for(unsigned int i=0;i<order.size();i++)
+		result.tuple.push_back(std::move(elements[order[i]]));
+	if(heapProfiler)
+		result.allocDelta = heapProfiler->allocate(HeapProfiler::TUPLE, HeapProfiler::valueBytes(result));
+	return result;
 }
 
+// The map builtins. MapPut m k v is m with k bound to v, MapGet m k the
+// value bound to k, MapHas m k whether there is one, MapSize m the number of
+// keys and MapToTuple m the (key, value) pairs in key order. Like Conc they
+// take all their arguments at once. Returns false for any other builtin
+bool CSEMachine::applyMapBuiltin(const Token& builtin, TokenStack &controlStack, TokenStack &executionStack){
+	const string& name = builtin.value;
+	int arguments = name == "MapPut" ? 3 : name == "MapGet" || name == "MapHas" ? 2
+			: name == "MapSize" || name == "MapToTuple" ? 1 : 0;
+	if(arguments == 0)
+		return false;
+	Token mapToken(std::move(executionStack.top()));
+	const PersistentMap& map = mapOperand(mapToken, name);
+	if(arguments == 1){
+		Token& result = executionStack.top();
+		if(name == "MapSize"){
+			result = Token(intToString(map.size()), Lexer::INT);
+			return true;
+		}
+		vector<const PersistentMap::Leaf*> entries = map.sortedEntries();
+		Token pairs(entries.empty() ? "nil" : "tuple", "tuple");
+		pairs.isTuple = true;
+		pairs.tuple.reserve(entries.size());
+		for(unsigned int i=0;i<entries.size();i++){
+			Token pair("tuple", "tuple");
+			pair.isTuple = true;
+			pair.tuple.push_back(entries[i]->key);
+			pair.tuple.push_back(entries[i]->value);
+			pairs.tuple.push_back(std::move(pair));
+		}
+		if(heapProfiler)
+			pairs.allocDelta = heapProfiler->allocate(HeapProfiler::TUPLE, HeapProfiler::valueBytes(pairs));
+		result = std::move(pairs);
+		return true;
+	}
+	executionStack.pop();
+	controlStack.pop();
+	Token key(std::move(executionStack.top()));
+	if(!PersistentMap::validKey(key))
+		throw runtime_error(name + " with a key that is not an integer, string or truth value");
+	if(name == "MapHas"){
+		executionStack.top() = truthToken(map.get(key) != NULL);
+	}else if(name == "MapGet"){
+		const Token* value = map.get(key);
+		if(value == NULL)
+			throw runtime_error("MapGet of a missing key " + key.value);
+		executionStack.top() = *value;
+	}else{
+		executionStack.pop();
+		controlStack.pop();
+		Token& result = executionStack.top();
+		std::shared_ptr<const PersistentMap> updated = map.put(key, result);
+		result = Token(MAP, MAP);
+		result.map = updated;
+	}
+	return true;
+}
 
-string CSEMachine::intToString(int intValue){
-	ostringstream oss;
-	oss<<intValue;
-	return oss.str();
+// The map a map builtin was given; MapEmpty is the empty map
+const PersistentMap& CSEMachine::mapOperand(const Token& value, const string& builtin){
+	if(value.type == MAP)
+		return *value.map;
+	if(value.type == Lexer::ID && value.value == "MapEmpty")
+		return emptyMap;
+	throw runtime_error(builtin + " applied to a non-map");
+}
+
+// A map as {key: value, ...}, in key order
+void CSEMachine::printMap(const PersistentMap& map){
+	vector<const PersistentMap::Leaf*> entries = map.sortedEntries();
+	*output << "{";
+	for(unsigned int i=0;i<entries.size();i++){
+		const Token* parts[] = { &entries[i]->key, &entries[i]->value };
+		for(int j=0;j<2;j++){
+			const Token& part = *parts[j];
+			if(part.type == Lexer::STR)
+				*output << unescape(part.value.substr(1, part.value.size()-2));
+			else if(part.type == MAP)
+				printMap(*part.map);
+			else
+				*output << part.value;
+			*output << (j == 0 ? ": " : i + 1 < entries.size() ? ", " : "");
+		}
+	}
+	*output << "}";
+}
+
+// base ** exponent by squaring in a machine word; false when it overflows.
+// A negative exponent truncates toward zero, as the floating-point pow did
+bool CSEMachine::powerFitsWord(long long base, long long exponent, long long& result){
+	if(exponent < 0){
+		if(base == 0)
+			throw runtime_error("Zero to a negative power");
+		result = base == 1 ? 1 : base == -1 ? (exponent % 2 == 0 ? 1 : -1) : 0;
+		return true;
+	}
+	result = 1;
+	while(exponent != 0){
+		if((exponent & 1) && __builtin_mul_overflow(result, base, &result))
+			return false;
+		exponent >>= 1;
+		if(exponent != 0 && __builtin_mul_overflow(base, base, &base))
+			return false;
+	}
+	return true;
+}
+
+// base ** exponent past a machine word. An exponent that is itself too
+// long for one only has a result for a base of 0, 1 or -1, or when negative
+BigInteger CSEMachine::bigPower(const BigInteger& base, const BigInteger& exponent){
+	string exponentText = exponent.toString();
+	long long exponentWord;
+	if(BigInteger::toWord(exponentText, exponentWord))
+		return exponentWord < 0 ? BigInteger(0) : base.power(exponentWord);
+	long long baseWord;
+	if(!BigInteger::toWord(base.toString(), baseWord) || baseWord < -1 || baseWord > 1){
+		if(!exponent.isNegative())
+			throw runtime_error("Exponent too large");
+		return BigInteger(0);
+	}
+	// Only the exponent's sign and parity matter now
+	long long odd = (exponentText[exponentText.size() - 1] - '0') % 2;
+	long long result;
+	powerFitsWord(baseWord, exponent.isNegative() ? -2 + odd : 2 + odd, result);
+	return BigInteger(result);
+}
+
+// Names a closure's delta after the identifier it is bound to. An eta is the
+// Y* wrapper of a recursive definition; the function it unrolls to is the
+// lambda its delta consists of, and takes the name as well
+void CSEMachine::nameClosure(const Token& value, const string& name){
+	if(value.type == "lambdaClosure"){
+		nameDelta(value.lambdaNum, name);
+	}else if(value.type == "eta"){
+		nameDelta(value.lambdaNum, "Y*(" + name + ")");
+		const vector<Token>& wrapper = code->deltas[value.lambdaNum];
+		if(wrapper.size() == 1 && wrapper[0].type == "lambdaClosure")
+			nameDelta(wrapper[0].lambdaNum, name);
+	}
+}
+
+// Passes a delta's name on to whichever of the profilers and tracer are on
+void CSEMachine::nameDelta(int deltaNum, const string& name){
+	if(profiler)
+		profiler->nameDelta(deltaNum, name);
+	if(tracer)
+		tracer->nameDelta(deltaNum, name);
+	if(heapProfiler)
+		heapProfiler->nameDelta(deltaNum, name);
+}
+
+// Decimal text of a machine word, built in a local buffer; up to 15
+// characters it fits the small-string buffer, so it does not allocate
+string CSEMachine::intToString(long long intValue){
+	char buffer[21];
+	char* end = buffer + sizeof(buffer);
+	char* digits = end;
+	unsigned long long magnitude = intValue < 0 ? 0ull - (unsigned long long)intValue : (unsigned long long)intValue;
+	do{
+		*--digits = '0' + magnitude % 10;
+		magnitude /= 10;
+	}while(magnitude != 0);
+	if(intValue < 0)
+		*--digits = '-';
+	return string(digits, end);
 }
 
 vector<string> CSEMachine::split(string inputString, char delimiter){
@@ -522,22 +2225,17 @@ bool CSEMachine::notFunction(string identifier){
 	return true;
 }
 
-bool CSEMachine::isParamter(Token currToken){
-	string varName = currToken.value;
-	int temp = currEnv;
-	pair<int,string> keyPair(temp,varName);
-	map<key_pair,Token>::iterator it = paramMap.find(keyPair);
-	while(paramMap.end() == it && temp>=0){
-		temp = envMap[temp];
-		keyPair.first = temp;
-		//cout << "Temp: "<<temp;
-		it = paramMap.find(keyPair);
-	}
-	if(paramMap.end() != it){
-		return true;
-	}else{
-		return false;
+// Value bound to name in the current environment or the nearest enclosing one;
+// NULL when the name is unbound (a builtin, or an error in the program)
+const Token* CSEMachine::lookupVariable(const string& name) const{
+	for(int env = currEnv; env >= 0; env = environments[env].parent){
+		const Environment& record = environments[env];
+		for(unsigned int i = record.firstBinding + record.bindingCount; i > record.firstBinding; i--){
+			if(bindings[i-1].name == name)
+				return &bindings[i-1].value;
+		}
 	}
+	return NULL;
 }
 
 
@@ -570,19 +2268,19 @@ void CSEMachine::printTuple(Token t){
 	vector<Token> tupleVector = t.tuple;
 	for(int i=0;i<tupleVector.size();i++){
 		if(i==0){
-			cout<<"(";
+			*output<<"(";
 		}else{
-			cout<<", ";
+			*output<<", ";
 		}
 		if(tupleVector[i].type == Lexer::STR){
-			cout<< unescape(tupleVector[i].value.substr(1,tupleVector[i].value.size()-2));
+			*output<< unescape(tupleVector[i].value.substr(1,tupleVector[i].value.size()-2));
 		}else if(tupleVector[i].type == "tuple"){
 			printTuple(tupleVector[i]);
 		}else{
-			cout << tupleVector[i].value;
+			*output << tupleVector[i].value;
 		}
 		if(i==tupleVector.size() -1){
-			cout<<")";
+			*output<<")";
 		}
 	}
 
@@ -3,49 +3,222 @@
 #define CSEMACHINE_H_
 
 #include <map>
+#include <memory>
+#include <ostream>
 #include <stack>
+#include <stdexcept>
 #include "Token.h"
 #include "TreeNode.h"
+#include "TreeArena.h"
+#include "RunStats.h"
+#include "LambdaProfiler.h"
+#include "ExecutionTracer.h"
+#include "HeapProfiler.h"
+#include "BigInteger.h"
 #include <list>
 #include <vector>
 #include <queue>
 #include <sstream>
 #include <utility>
+#include <string>
+#include <unordered_set>
 
 using namespace std;
-typedef map<string,Token> envMap;
-typedef pair<int,string> keyPair;
+typedef stack<Token, vector<Token> > TokenStack;
+
+// A name bound to a value. The bindings an environment introduces are
+// created together, so they sit next to each other in the bindings table
+struct Binding {
+	string name;
+	Token value;
+};
+
+// Environment record: the enclosing environment (-1 for the primitive one)
+// and the slice of the bindings table it introduced
+struct Environment {
+	int parent;
+	unsigned int firstBinding;
+	unsigned int bindingCount;
+	bool frameLocal;        // A call frame nothing can reference once the call returns
+};
+
+// A delayed argument under lazy evaluation: the delta computing it and the
+// environment to run that in, then its value once forced. Thunk tokens
+// refer to one by index, so every copy of a thunk shares the value
+struct Thunk {
+	int deltaNum;
+	int env;
+	bool forced;
+	Token value;
+};
+
+// A control sequence fused into one superinstruction. The token standing in
+// for it holds the entry's index in fusedIndex; tokens are the originals in
+// delta order. An application whose function binding-time analysis resolved
+// is a known call: callee is the lambda the identifier is bound to, or the
+// Y* wrapper of a rec definition when recursiveCallee is set
+struct Superinstruction {
+	enum Kind {
+		OP_VAR_INT,         // OPT ID INT        x op n
+		BRANCH_OP,          // beta OPT          a op b -> ... | ...
+		BRANCH_VAR_INT,     // beta OPT ID INT   x op n -> ... | ...
+		APPLY_VAR,          // gamma ID          f E
+		APPLY_VAR_VAR       // gamma ID ID       f x
+	};
+	Kind kind;
+	vector<Token> tokens;
+	bool knownCall;
+	bool recursiveCallee;
+	Token callee;
+};
+
+// A program's control structures and what the analyses found in them. The
+// machine given the standardized tree builds them - rewriting the tree as
+// it goes - and afterwards they are only read, so any number of machines
+// can run the program from them, on any thread
+struct ControlStructures {
+	vector<vector<Token> > deltas;  // Indexed by delta number
+	vector<Superinstruction> superinstructions;
+	vector<bool> curriedDeltas;     // Deltas consisting of a single lambda
+	vector<bool> flatClosures;      // By delta: closures of this lambda capture their free variables
+	vector<vector<string> > capturedNames;  // By delta: the free variables those closures capture
+	vector<bool> primitiveOperands;  // By delta: delayed operands made of operators, literals and variables
+	vector<bool> frameLocalDeltas;  // By delta: running it creates no closure that could outlive its frame
+	bool lazy;                      // Built for call by need
+};
+
+// Evaluation stopped by the step or memory limit rather than by the program
+class EvaluationLimit : public runtime_error {
+public:
+	enum Kind { STEPS, MEMORY };
+	EvaluationLimit(Kind kind, const string& message) : runtime_error(message), kind(kind) {}
+	Kind kind;
+};
 
 class CSEMachine {
+	friend class MachineBenchmark;  // Benchmarks/MicroBenchmark.cpp times the private primitives
+	friend class ControlNgrams;     // Benchmarks/ControlNgrams.cpp mines the unfused control structures
 public:
 	CSEMachine();
-	CSEMachine(TreeNode* input);
+	CSEMachine(TreeNode* input, const TreeArena* arena);
+	explicit CSEMachine(shared_ptr<const ControlStructures> code);  // Runs a program compiled by another machine
 	virtual ~CSEMachine();
+	shared_ptr<const ControlStructures> compile();
 	void evaluateTree();
+	void setOutput(ostream* output);
+	void setStats(RunStats* stats);
+	void setProfiler(LambdaProfiler* profiler);
+	void setTracer(ExecutionTracer* tracer);
+	void setHeapProfiler(HeapProfiler* heapProfiler);
+	void setStepLimit(unsigned long long maxSteps);
+	void setMemoryLimit(unsigned long long maxBytes);
+	void setSuperinstructions(bool enabled);
+	void setUncurrying(bool enabled);
+	void setFlatClosures(bool enabled);
+	void setKnownCalls(bool enabled);
+	void setStrictBooleans(bool enabled);
+	void setLazy(bool enabled);
+	unsigned long long stepsTaken() const { return stepCount; }
+	unsigned long long peakBytes() const { return peakMemory; }
 private:
-	map<int, vector<Token> > deltaMap;
+	unsigned long long maxSteps;
+	unsigned long long maxMemory;   // Bytes; 0 is unlimited
+	unsigned long long peakMemory;
+	bool superinstructionsEnabled;
+	bool uncurryingEnabled;
+	bool flatClosuresEnabled;
+	bool knownCallsEnabled;
+	bool strictBooleans;            // or and & evaluate both operands
+	bool lazyEnabled;               // Call by need: arguments and let bindings are thunks
+	vector<Thunk> thunks;
+	unsigned long long reclaimedEnvironments;
+	RunStats* stats;
+	LambdaProfiler* profiler;
+	ExecutionTracer* tracer;
+	HeapProfiler* heapProfiler;
+	unsigned long long stepCount;
+	shared_ptr<const ControlStructures> code;   // NULL until compiled
+	ControlStructures* compiling;   // The structures createControlStructures is building
+	ostream* output;                // Where Print writes
 	ostringstream oss;
 	int deltaCounter;
 	int currDeltaNum;
 	int envCounter;
-	queue<TreeNode*> pendingDeltaQueue;
+	queue<TreeNode*> pendingDeltaQueue;     // NULL stands for the next of pendingConstants
+	queue<Token> pendingConstants;
+	unordered_set<int> truthDeltas;         // Short-circuited right operands turned into truth values
+	unordered_set<string> boundNames;       // Every name the program binds, so builtins it shadows are not taken for pure
 	TreeNode* inputTree;
-	//map<int, envMap> paramMap;
-	map<keyPair,Token> paramMap;
+	const TreeArena* arena;
+	vector<Environment> environments;       // Indexed by environment number
+	vector<Binding> bindings;
 	void createControlStructures(TreeNode* root);
+	unsigned long long machineBytes(const TokenStack &controlStack, const TokenStack &executionStack) const;
 	void preOrderTraversal(TreeNode* root, vector<Token> &currentDelta);
-	void processCurrentToken(Token &currToken, stack<Token> &controlStack, stack<Token> &executionStack);
-	Token applyOperator(Token firstToken, Token secondToken, Token currToken);
-	string intToString(int intValue);
+	void collectBoundNames(TreeNode* root);
+	bool mayHaveEffects(TreeNode* operand) const;
+	void delayOperand(TreeNode* operand, vector<Token> &currentDelta);
+	bool isPrimitiveOperand(TreeNode* operand) const;
+	bool operandsForced(int deltaNum) const;
+	void forceThunk(int thunkNum, TokenStack &controlStack, TokenStack &executionStack);
+	bool forceArguments(Token& rator, TokenStack &controlStack, TokenStack &executionStack);
+	void collectPartial(const Token& builtin, unsigned int supplied, TokenStack &controlStack, TokenStack &executionStack);
+	void resumePartial(Token& partial, TokenStack &controlStack, TokenStack &executionStack);
+	bool applySequenceBuiltin(const Token& builtin, TokenStack &controlStack, TokenStack &executionStack);
+	void foldStep(Token& step, TokenStack &controlStack, TokenStack &executionStack);
+	int primitiveFoldOperator(const Token& function) const;
+	Token foldPrimitive(int operatorDelta, const string& accumulatorName, Token accumulator, const Token& sequence);
+	bool applyVectorBuiltin(const Token& builtin, TokenStack &controlStack, TokenStack &executionStack);
+	const vector<int64_t>* packTuple(Token& tuple, const string& builtin);
+	Token combineUnpacked(const string& name, const vector<Token>& a, const vector<Token>& b);
+	Token integerTuple(const vector<int64_t>& values);
+	bool applySortBuiltin(const Token& builtin, TokenStack &controlStack, TokenStack &executionStack);
+	void mergeStep(Token& state, TokenStack &controlStack, TokenStack &executionStack);
+	void sortKeyStep(Token& state, TokenStack &controlStack, TokenStack &executionStack);
+	vector<unsigned int> naturalOrder(const vector<Token>& keys, const string& builtin);
+	Token permutedTuple(vector<Token>& elements, const vector<unsigned int>& order);
+	bool applyMapBuiltin(const Token& builtin, TokenStack &controlStack, TokenStack &executionStack);
+	const PersistentMap& mapOperand(const Token& value, const string& builtin);
+	void printMap(const PersistentMap& map);
+	void processCurrentToken(Token &currToken, TokenStack &controlStack, TokenStack &executionStack);
+	void applyGamma(TokenStack &controlStack, TokenStack &executionStack);
+	void enterClosure(const Token& closure, int parent, TokenStack &controlStack, TokenStack &executionStack);
+	bool applyKnownCall(const Superinstruction& call, TokenStack &controlStack, TokenStack &executionStack);
+	void fuseSuperinstructions(vector<Token> &delta);
+	void executeSuperinstruction(const Token &fusedToken, TokenStack &controlStack, TokenStack &executionStack);
+	void pushVariable(const Token &identifier, TokenStack &executionStack);
+	Token applyOperator(const Token& firstToken, const Token& secondToken, const Token& currToken);
+	bool powerFitsWord(long long base, long long exponent, long long& result);
+	BigInteger bigPower(const BigInteger& base, const BigInteger& exponent);
+	string intToString(long long intValue);
 	vector<string> split(string inputString, char delimiter);
 	bool notFunction(string value);
-	bool isParamter(Token currToken);
-	map<int,int> envMap;
-	stack<int> envStack;
+	const Token* lookupVariable(const string& name) const;
+	void bindParameters(const Token& closure, Token& argument, Environment& env);
+	int bindArguments(const Token& closure, int parent, TokenStack &controlStack, TokenStack &executionStack);
+	void analyzeFreeVariables();
+	void collectFreeVariables(const Token& token, const vector<vector<string> >& deltaFree, vector<string>& names);
+	int captureEnvironment(int lambdaNum);
+	void analyzeEscapes();
+	bool keepsFrameLocal(const vector<Token>& delta, unsigned int i) const;
+	void releaseFrame(int envNum);
+	void resolveKnownCalls();
+	void pushDelta(int deltaNum, TokenStack &controlStack);
+	stack<int, vector<int> > envStack;
 	int currEnv;
 	bool printCalled;
 	string unescape(const string& s);
 	void printTuple(Token t);
+	void nameClosure(const Token& value, const string& name);
+	void nameDelta(int deltaNum, const string& name);
+	void snapshotHeap(const TokenStack &executionStack);
+
+	// Preallocated results, copied instead of built on every step
+	const Token trueToken;
+	const Token falseToken;
+	const Token dummyToken;
+	const Token gammaToken;
+	const Token& truthToken(bool value) const { return value ? trueToken : falseToken; }
 };
 
 
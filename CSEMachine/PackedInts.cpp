@@ -0,0 +1,255 @@
+/**
+ * Packed Integer Kernels Implementation
+ *
+ * Each kernel is a portable loop plus, on x86 with GCC or Clang, an AVX2
+ * version compiled for that target alone, so the rest of the interpreter
+ * keeps running on CPUs without it. The AVX2 versions work on four 64-bit
+ * lanes at a time. Sums wrap and keep a sticky overflow flag: a sum
+ * overflowed when it differs in sign from both its operands. Where the two
+ * versions add in a different order one may report an overflow the other
+ * does not, which only sends the builtin to its exact path; a result either
+ * returns is the same.
+ */
+
+#include "PackedInts.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PACKED_INTS_AVX2
+#include <immintrin.h>
+#endif
+
+// Portable loops
+
+static bool sumPortable(const int64_t* values, size_t count, int64_t& result) {
+	uint64_t total = 0;
+	uint64_t overflow = 0;
+	for(size_t i = 0; i < count; i++) {
+		uint64_t value = values[i];
+		uint64_t next = total + value;
+		overflow |= (total ^ next) & (value ^ next);
+		total = next;
+	}
+	result = (int64_t)total;
+	return (int64_t)overflow >= 0;
+}
+
+static int64_t maxPortable(const int64_t* values, size_t count) {
+	int64_t best = values[0];
+	for(size_t i = 1; i < count; i++)
+		best = values[i] > best ? values[i] : best;
+	return best;
+}
+
+static int64_t minPortable(const int64_t* values, size_t count) {
+	int64_t best = values[0];
+	for(size_t i = 1; i < count; i++)
+		best = values[i] < best ? values[i] : best;
+	return best;
+}
+
+static bool dotPortable(const int64_t* a, const int64_t* b, size_t count, int64_t& result) {
+	int64_t total = 0;
+	for(size_t i = 0; i < count; i++) {
+		int64_t product;
+		if(__builtin_mul_overflow(a[i], b[i], &product) || __builtin_add_overflow(total, product, &total))
+			return false;
+	}
+	result = total;
+	return true;
+}
+
+static bool addPortable(const int64_t* a, const int64_t* b, int64_t* out, size_t count) {
+	uint64_t overflow = 0;
+	for(size_t i = 0; i < count; i++) {
+		uint64_t x = a[i], y = b[i];
+		uint64_t sum = x + y;
+		overflow |= (x ^ sum) & (y ^ sum);
+		out[i] = (int64_t)sum;
+	}
+	return (int64_t)overflow >= 0;
+}
+
+static bool multiplyPortable(const int64_t* a, const int64_t* b, int64_t* out, size_t count) {
+	for(size_t i = 0; i < count; i++) {
+		if(__builtin_mul_overflow(a[i], b[i], &out[i]))
+			return false;
+	}
+	return true;
+}
+
+#ifdef PACKED_INTS_AVX2
+
+// AVX2 versions - four 64-bit lanes at a time, the remainder through the
+// portable loop
+
+static bool detectAvx2() {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+
+static const bool hasAvx2 = detectAvx2();
+
+__attribute__((target("avx2")))
+static __m256i load(const int64_t* values) {
+	return _mm256_loadu_si256((const __m256i*)values);
+}
+
+// x + y lane by lane, wrapping; lanes that overflowed get their sign bit set in overflow
+__attribute__((target("avx2")))
+static __m256i addLanes(__m256i x, __m256i y, __m256i& overflow) {
+	__m256i sum = _mm256_add_epi64(x, y);
+	overflow = _mm256_or_si256(overflow, _mm256_and_si256(_mm256_xor_si256(x, sum), _mm256_xor_si256(y, sum)));
+	return sum;
+}
+
+__attribute__((target("avx2")))
+static bool anySignSet(__m256i lanes) {
+	return _mm256_movemask_pd(_mm256_castsi256_pd(lanes)) != 0;
+}
+
+// Adds the four lanes into total; false when that overflows
+__attribute__((target("avx2")))
+static bool foldLanes(__m256i lanes, int64_t& total) {
+	int64_t values[4];
+	_mm256_storeu_si256((__m256i*)values, lanes);
+	for(int i = 0; i < 4; i++) {
+		if(__builtin_add_overflow(total, values[i], &total))
+			return false;
+	}
+	return true;
+}
+
+// Whether every lane of a and b fits 32 bits. AVX2 multiplies only the
+// sign-extended low halves of 64-bit lanes, which are then whole values
+// and their products exact
+__attribute__((target("avx2")))
+static bool fitInt32(__m256i a, __m256i b) {
+	const __m256i high = _mm256_set1_epi64x(INT32_MAX);
+	const __m256i low = _mm256_set1_epi64x(INT32_MIN);
+	__m256i outside = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpgt_epi64(a, high), _mm256_cmpgt_epi64(low, a)),
+			_mm256_or_si256(_mm256_cmpgt_epi64(b, high), _mm256_cmpgt_epi64(low, b)));
+	return _mm256_testz_si256(outside, outside);
+}
+
+__attribute__((target("avx2")))
+static bool sumAvx2(const int64_t* values, size_t count, int64_t& result) {
+	__m256i total = _mm256_setzero_si256();
+	__m256i overflow = _mm256_setzero_si256();
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+		total = addLanes(total, load(values + i), overflow);
+	if(anySignSet(overflow) || !sumPortable(values + i, count - i, result))
+		return false;
+	return foldLanes(total, result);
+}
+
+__attribute__((target("avx2")))
+static int64_t maxAvx2(const int64_t* values, size_t count) {
+	__m256i best = _mm256_set1_epi64x(values[0]);
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4) {
+		__m256i next = load(values + i);
+		best = _mm256_blendv_epi8(best, next, _mm256_cmpgt_epi64(next, best));
+	}
+	int64_t lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, best);
+	int64_t result = maxPortable(lanes, 4);
+	for(; i < count; i++)
+		result = values[i] > result ? values[i] : result;
+	return result;
+}
+
+__attribute__((target("avx2")))
+static int64_t minAvx2(const int64_t* values, size_t count) {
+	__m256i best = _mm256_set1_epi64x(values[0]);
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4) {
+		__m256i next = load(values + i);
+		best = _mm256_blendv_epi8(best, next, _mm256_cmpgt_epi64(best, next));
+	}
+	int64_t lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, best);
+	int64_t result = minPortable(lanes, 4);
+	for(; i < count; i++)
+		result = values[i] < result ? values[i] : result;
+	return result;
+}
+
+// Blocks of 32-bit values multiply in the lanes; any other block goes
+// through the checked portable loop into a running scalar total
+__attribute__((target("avx2")))
+static bool dotAvx2(const int64_t* a, const int64_t* b, size_t count, int64_t& result) {
+	__m256i total = _mm256_setzero_si256();
+	__m256i overflow = _mm256_setzero_si256();
+	int64_t rest = 0;
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4) {
+		__m256i x = load(a + i);
+		__m256i y = load(b + i);
+		if(fitInt32(x, y)) {
+			total = addLanes(total, _mm256_mul_epi32(x, y), overflow);
+		} else {
+			int64_t block;
+			if(!dotPortable(a + i, b + i, 4, block) || __builtin_add_overflow(rest, block, &rest))
+				return false;
+		}
+	}
+	int64_t tail;
+	if(anySignSet(overflow) || !dotPortable(a + i, b + i, count - i, tail) || __builtin_add_overflow(rest, tail, &rest))
+		return false;
+	result = rest;
+	return foldLanes(total, result);
+}
+
+__attribute__((target("avx2")))
+static bool addAvx2(const int64_t* a, const int64_t* b, int64_t* out, size_t count) {
+	__m256i overflow = _mm256_setzero_si256();
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+		_mm256_storeu_si256((__m256i*)(out + i), addLanes(load(a + i), load(b + i), overflow));
+	return !anySignSet(overflow) && addPortable(a + i, b + i, out + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static bool multiplyAvx2(const int64_t* a, const int64_t* b, int64_t* out, size_t count) {
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4) {
+		__m256i x = load(a + i);
+		__m256i y = load(b + i);
+		if(fitInt32(x, y))
+			_mm256_storeu_si256((__m256i*)(out + i), _mm256_mul_epi32(x, y));
+		else if(!multiplyPortable(a + i, b + i, out + i, 4))
+			return false;
+	}
+	return multiplyPortable(a + i, b + i, out + i, count - i);
+}
+
+#define DISPATCH(avx2, portable) (hasAvx2 ? avx2 : portable)
+#else
+#define DISPATCH(avx2, portable) (portable)
+#endif
+
+bool PackedInts::sum(const int64_t* values, size_t count, int64_t& result) {
+	return DISPATCH(sumAvx2, sumPortable)(values, count, result);
+}
+
+int64_t PackedInts::max(const int64_t* values, size_t count) {
+	return DISPATCH(maxAvx2, maxPortable)(values, count);
+}
+
+int64_t PackedInts::min(const int64_t* values, size_t count) {
+	return DISPATCH(minAvx2, minPortable)(values, count);
+}
+
+bool PackedInts::dot(const int64_t* a, const int64_t* b, size_t count, int64_t& result) {
+	return DISPATCH(dotAvx2, dotPortable)(a, b, count, result);
+}
+
+bool PackedInts::add(const int64_t* a, const int64_t* b, int64_t* out, size_t count) {
+	return DISPATCH(addAvx2, addPortable)(a, b, out, count);
+}
+
+bool PackedInts::multiply(const int64_t* a, const int64_t* b, int64_t* out, size_t count) {
+	return DISPATCH(multiplyAvx2, multiplyPortable)(a, b, out, count);
+}
@@ -0,0 +1,33 @@
+/**
+ * Packed Integer Kernels Header
+ *
+ * Loops over contiguous 64-bit integer arrays for the vector builtins (Sum,
+ * Max, Min, Dot, Add and Mul), which run them on the packed form of
+ * all-integer tuples. Every element is a machine word; the kernels that can
+ * overflow one report it instead of wrapping, and the builtin then works
+ * exactly on the elements themselves. On x86 an AVX2 version of each kernel
+ * is chosen at run time when the CPU has it; otherwise the portable loops
+ * are used, which the compiler vectorizes for the baseline instruction set
+ * (SSE2 on x86-64) where it can.
+ */
+
+#ifndef PACKEDINTS_H_
+#define PACKEDINTS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+class PackedInts {
+public:
+	// False when a partial sum overflows 64 bits
+	static bool sum(const int64_t* values, size_t count, int64_t& result);
+	static int64_t max(const int64_t* values, size_t count);     // count must not be 0
+	static int64_t min(const int64_t* values, size_t count);     // count must not be 0
+	// False when a product or a partial sum overflows 64 bits
+	static bool dot(const int64_t* a, const int64_t* b, size_t count, int64_t& result);
+	// False when an element overflows 64 bits; out is then partly written
+	static bool add(const int64_t* a, const int64_t* b, int64_t* out, size_t count);
+	static bool multiply(const int64_t* a, const int64_t* b, int64_t* out, size_t count);
+};
+
+#endif /* PACKEDINTS_H_ */
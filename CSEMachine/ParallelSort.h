@@ -0,0 +1,83 @@
+/**
+ * Parallel Stable Sort Header
+ *
+ * Stable sort of a permutation for the Sort and SortBy builtins. Small
+ * inputs go to std::stable_sort. Large ones are cut into one slice per
+ * hardware thread, the slices are sorted on their own threads and then
+ * merged pairwise, each round's merges again running in parallel. Both
+ * steps are stable - a merge takes from the left slice on ties - so the
+ * result is the same for any number of threads. When no thread can be
+ * started the work simply runs on the calling one.
+ */
+
+#ifndef PARALLELSORT_H_
+#define PARALLELSORT_H_
+
+#include <algorithm>
+#include <functional>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// Below this many elements one thread sorts faster than several
+static const size_t PARALLEL_SORT_MIN = 1 << 15;
+
+// Runs every task, all but the first on threads of their own, and waits for them
+inline void runTasks(const std::vector<std::function<void()> >& tasks) {
+	std::vector<std::thread> threads;
+	size_t inlineFrom = tasks.size();
+	for(size_t i = 1; i < tasks.size(); i++) {
+		try {
+			threads.push_back(std::thread(tasks[i]));
+		} catch(const std::system_error&) {
+			inlineFrom = i;
+			break;
+		}
+	}
+	if(!tasks.empty())
+		tasks[0]();
+	for(size_t i = inlineFrom; i < tasks.size(); i++)
+		tasks[i]();
+	for(size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+}
+
+template <typename Less>
+void parallelStableSort(std::vector<unsigned int>& order, Less less) {
+	size_t slices = std::min<size_t>(std::thread::hardware_concurrency(), order.size() / PARALLEL_SORT_MIN);
+	if(slices < 2) {
+		std::stable_sort(order.begin(), order.end(), less);
+		return;
+	}
+	std::vector<size_t> bounds;
+	for(size_t i = 0; i <= slices; i++)
+		bounds.push_back(order.size() * i / slices);
+
+	std::vector<std::function<void()> > tasks;
+	for(size_t i = 0; i < slices; i++) {
+		std::vector<unsigned int>::iterator first = order.begin() + bounds[i];
+		std::vector<unsigned int>::iterator last = order.begin() + bounds[i + 1];
+		tasks.push_back([first, last, less]() { std::stable_sort(first, last, less); });
+	}
+	runTasks(tasks);
+
+	while(bounds.size() > 2) {
+		tasks.clear();
+		std::vector<size_t> merged;
+		for(size_t i = 0; i + 2 < bounds.size(); i += 2) {
+			std::vector<unsigned int>::iterator first = order.begin() + bounds[i];
+			std::vector<unsigned int>::iterator middle = order.begin() + bounds[i + 1];
+			std::vector<unsigned int>::iterator last = order.begin() + bounds[i + 2];
+			tasks.push_back([first, middle, last, less]() { std::inplace_merge(first, middle, last, less); });
+			merged.push_back(bounds[i]);
+		}
+		// An odd slice out waits for the next round
+		if(bounds.size() % 2 == 0)
+			merged.push_back(bounds[bounds.size() - 2]);
+		merged.push_back(bounds.back());
+		runTasks(tasks);
+		bounds.swap(merged);
+	}
+}
+
+#endif /* PARALLELSORT_H_ */
@@ -0,0 +1,175 @@
+/**
+ * Persistent Map Implementation
+ *
+ * Integer keys are compared and hashed by their digits without leading
+ * zeros, so 7 and 007 are the same key; strings by their text and truth
+ * values by their type. Entries are listed with integers in numeric order,
+ * strings in text order and false before true.
+ */
+
+#include "PersistentMap.h"
+#include "Lexer.h"
+#include <algorithm>
+
+using namespace std;
+
+static const unsigned int BITS_PER_LEVEL = 5;
+static const unsigned int FNV_OFFSET = 2166136261u;
+static const unsigned int FNV_PRIME = 16777619u;
+
+// Digits of an integer without leading zeros, after the sign if negative
+static string canonicalInteger(const string& text) {
+	size_t start = text[0] == '-' ? 1 : 0;
+	size_t digits = text.find_first_not_of('0', start);
+	if(digits == string::npos)
+		return "0";
+	return start == 1 ? "-" + text.substr(digits) : text.substr(digits);
+}
+
+// Numeric order of two canonical integers
+static int compareIntegers(const string& a, const string& b) {
+	bool negativeA = a[0] == '-';
+	bool negativeB = b[0] == '-';
+	if(negativeA != negativeB)
+		return negativeA ? -1 : 1;
+	int magnitude = a.size() != b.size() ? (a.size() < b.size() ? -1 : 1) : a.compare(b);
+	return negativeA ? -magnitude : magnitude;
+}
+
+static int keyRank(const Token& key) {
+	return key.type == Lexer::INT ? 0 : key.type == Lexer::STR ? 1 : 2;
+}
+
+PersistentMap::PersistentMap() {
+	count = 0;
+}
+
+bool PersistentMap::validKey(const Token& key) {
+	return !key.isTuple && (key.type == Lexer::INT || key.type == Lexer::STR || key.type == "true" || key.type == "false");
+}
+
+unsigned int PersistentMap::hashKey(const Token& key) {
+	unsigned int hash = FNV_OFFSET;
+	hash = (hash ^ (unsigned char)keyRank(key)) * FNV_PRIME;
+	const string bytes = key.type == Lexer::INT ? canonicalInteger(key.value) : key.type == Lexer::STR ? key.value : key.type;
+	for(size_t i = 0; i < bytes.size(); i++)
+		hash = (hash ^ (unsigned char)bytes[i]) * FNV_PRIME;
+	return hash;
+}
+
+bool PersistentMap::sameKey(const Token& a, const Token& b) {
+	if(a.type != b.type)
+		return false;
+	if(a.type == Lexer::INT)
+		return canonicalInteger(a.value) == canonicalInteger(b.value);
+	return a.value == b.value;
+}
+
+/**
+ * Inserts a leaf below node, which sits at the given hash shift; returns the
+ * new node, sharing every child the insertion did not pass through
+ */
+shared_ptr<const PersistentMap::Node> PersistentMap::insert(const shared_ptr<const Node>& node, unsigned int shift,
+		const shared_ptr<const Leaf>& leaf, bool& added) {
+	shared_ptr<Node> copy = node ? make_shared<Node>(*node) : make_shared<Node>();
+	if(!node)
+		copy->bitmap = 0;
+	Entry entry;
+	entry.leaf = leaf;
+	// Below the last level the whole hash is used up: keys are kept in a list
+	if(shift >= 32) {
+		for(size_t i = 0; i < copy->entries.size(); i++) {
+			if(sameKey(copy->entries[i].leaf->key, leaf->key)) {
+				copy->entries[i] = entry;
+				added = false;
+				return copy;
+			}
+		}
+		copy->entries.push_back(entry);
+		added = true;
+		return copy;
+	}
+	unsigned int bit = 1u << ((leaf->hash >> shift) & 31);
+	unsigned int index = __builtin_popcount(copy->bitmap & (bit - 1));
+	if(!(copy->bitmap & bit)) {
+		copy->bitmap |= bit;
+		copy->entries.insert(copy->entries.begin() + index, entry);
+		added = true;
+	} else if(copy->entries[index].child) {
+		copy->entries[index].child = insert(copy->entries[index].child, shift + BITS_PER_LEVEL, leaf, added);
+	} else if(sameKey(copy->entries[index].leaf->key, leaf->key)) {
+		copy->entries[index] = entry;
+		added = false;
+	} else {
+		// Two keys in one slot: both move down a level
+		bool ignored;
+		shared_ptr<const Node> child = insert(shared_ptr<const Node>(), shift + BITS_PER_LEVEL, copy->entries[index].leaf, ignored);
+		copy->entries[index].leaf.reset();
+		copy->entries[index].child = insert(child, shift + BITS_PER_LEVEL, leaf, added);
+	}
+	return copy;
+}
+
+shared_ptr<const PersistentMap> PersistentMap::put(const Token& key, const Token& value) const {
+	shared_ptr<Leaf> leaf = make_shared<Leaf>();
+	leaf->hash = hashKey(key);
+	leaf->key = key;
+	if(key.type == Lexer::INT)
+		leaf->key.value = canonicalInteger(key.value);
+	leaf->value = value;
+	bool added = false;
+	shared_ptr<PersistentMap> result = make_shared<PersistentMap>();
+	result->root = insert(root, 0, leaf, added);
+	result->count = count + (added ? 1 : 0);
+	return result;
+}
+
+const Token* PersistentMap::get(const Token& key) const {
+	unsigned int hash = hashKey(key);
+	const Node* node = root.get();
+	for(unsigned int shift = 0; node != NULL; shift += BITS_PER_LEVEL) {
+		if(shift >= 32) {
+			for(size_t i = 0; i < node->entries.size(); i++) {
+				if(sameKey(node->entries[i].leaf->key, key))
+					return &node->entries[i].leaf->value;
+			}
+			return NULL;
+		}
+		unsigned int bit = 1u << ((hash >> shift) & 31);
+		if(!(node->bitmap & bit))
+			return NULL;
+		const Entry& entry = node->entries[__builtin_popcount(node->bitmap & (bit - 1))];
+		if(!entry.child)
+			return sameKey(entry.leaf->key, key) ? &entry.leaf->value : NULL;
+		node = entry.child.get();
+	}
+	return NULL;
+}
+
+void PersistentMap::collect(const Node& node, vector<const Leaf*>& leaves) {
+	for(size_t i = 0; i < node.entries.size(); i++) {
+		if(node.entries[i].child)
+			collect(*node.entries[i].child, leaves);
+		else
+			leaves.push_back(node.entries[i].leaf.get());
+	}
+}
+
+vector<const PersistentMap::Leaf*> PersistentMap::sortedEntries() const {
+	vector<const Leaf*> leaves;
+	leaves.reserve(count);
+	if(root)
+		collect(*root, leaves);
+	sort(leaves.begin(), leaves.end(), [](const Leaf* a, const Leaf* b) {
+		int rankA = keyRank(a->key);
+		int rankB = keyRank(b->key);
+		if(rankA != rankB)
+			return rankA < rankB;
+		if(rankA == 0)
+			return compareIntegers(canonicalInteger(a->key.value), canonicalInteger(b->key.value)) < 0;
+		if(rankA == 1)
+			return a->key.value.compare(1, a->key.value.size() - 2, b->key.value, 1, b->key.value.size() - 2) < 0;
+		return a->key.value < b->key.value;
+	});
+	return leaves;
+}
@@ -0,0 +1,62 @@
+/**
+ * Persistent Map Header
+ *
+ * Immutable map from integer, string and truth value keys to any values,
+ * the value behind the Map builtins. It is a hash array mapped trie: each
+ * level takes five bits of the key's hash and keeps only the slots in use,
+ * found through a 32-bit bitmap, so a lookup or an insert visits at most
+ * seven levels. Inserting copies only the path from the root to the key;
+ * every other node is shared with the map it was made from. Keys whose
+ * hashes agree in all 32 bits share a collision node below the last level.
+ * The hash is computed here rather than by std::hash, so iteration order
+ * is the same on every platform.
+ */
+
+#ifndef PERSISTENTMAP_H_
+#define PERSISTENTMAP_H_
+
+#include <memory>
+#include <vector>
+#include "Token.h"
+
+class PersistentMap {
+public:
+	struct Leaf {
+		unsigned int hash;
+		Token key;
+		Token value;
+	};
+
+	PersistentMap();
+
+	static bool validKey(const Token& key);                        // An integer, a string or a truth value
+	std::shared_ptr<const PersistentMap> put(const Token& key, const Token& value) const;
+	const Token* get(const Token& key) const;                      // NULL when the key is absent
+	size_t size() const { return count; }
+	std::vector<const Leaf*> sortedEntries() const;                // Integers, then strings, then truth values
+
+private:
+	struct Node;
+
+	// A slot holds either a key and its value or the next level down
+	struct Entry {
+		std::shared_ptr<const Leaf> leaf;
+		std::shared_ptr<const Node> child;
+	};
+
+	struct Node {
+		unsigned int bitmap;          // Hash fragments present; 0 in a collision node
+		std::vector<Entry> entries;   // One per set bit, in bit order
+	};
+
+	std::shared_ptr<const Node> root;
+	size_t count;
+
+	static unsigned int hashKey(const Token& key);
+	static bool sameKey(const Token& a, const Token& b);
+	static std::shared_ptr<const Node> insert(const std::shared_ptr<const Node>& node, unsigned int shift,
+			const std::shared_ptr<const Leaf>& leaf, bool& added);
+	static void collect(const Node& node, std::vector<const Leaf*>& leaves);
+};
+
+#endif /* PERSISTENTMAP_H_ */
@@ -2,20 +2,21 @@
 #include <fstream>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <stdexcept>
 #include <exception>
+#include <memory>
 
-#include "Lexer.h"
-#include "Standardizer.h"
-#include "TreeNode.h"
-#include "CSEMachine.h"
-#include "Parser.h"
+#include "Program.h"
+#include "Execution.h"
+#include "RunStats.h"
+#include "LambdaProfiler.h"
+#include "HardwareCounters.h"
+#include "ExecutionTracer.h"
+#include "HeapProfiler.h"
 
 using namespace std;
 
-void preOrder(TreeNode* t, std::string dots);
-void formattedPrint(Token t,std::string dots);
-
 // Enhanced file opening with comprehensive error handling
 string openFile(char* fileName){
 	if (fileName == nullptr || strlen(fileName) == 0) {
@@ -69,171 +70,262 @@ string openFile(char* fileName){
 	return file_content;
 }
 
-// Safe parsing with error handling
-bool safeParseAndProcess(const string& code_string, bool ast_switch, bool st_switch, bool evaluate_only) {
-	try {
-		// Lexical Analysis Phase
-		Lexer* lexer = new Lexer(code_string);
-		if (!lexer) {
-			cerr << "Error: Failed to create lexer" << endl;
-			return false;
-		}
-
-		// Parsing Phase
-		Parser* parser = new Parser(lexer);
-		if (!parser) {
-			cerr << "Error: Failed to create parser" << endl;
-			delete lexer;
-			return false;
-		}
-
-		try {
-			parser->parse();
-		} catch (const exception& e) {
-			cerr << "Error: Parsing failed - " << e.what() << endl;
-			cerr << "Please check your program syntax." << endl;
-			delete parser;
-			delete lexer;
-			return false;
-		}
+// Command line switches - the last argument that is not an option names the program file
+struct CommandLineOptions {
+	CommandLineOptions() : fileName(nullptr), astSwitch(false), stSwitch(false), profile(false), maxSteps(0), maxMemory(0), hwCounters(false), traceSample(1), heapProfile(false), strictBooleans(false), lazy(false) {}
+
+	char* fileName;
+	bool astSwitch;
+	bool stSwitch;
+	string statsFormat;     // "text" or "json"; empty when --stats is off
+	string statsFile;       // Report destination; stderr when empty
+	bool profile;           // Per-lambda profile table on stderr
+	string foldedFile;      // Folded-stack output for flamegraph tools
+	unsigned long long maxSteps;    // Evaluation step limit; 0 is unlimited
+	unsigned long long maxMemory;   // Machine memory limit in bytes; 0 is unlimited
+	bool hwCounters;        // CPU performance counters per phase in the statistics report
+	string traceFile;       // Chrome trace-event output; empty when --trace is off
+	unsigned int traceSample;       // Record every nth closure application and builtin call
+	bool heapProfile;       // Bytes allocated and live per creating lambda
+	bool strictBooleans;    // Evaluate both operands of or and &
+	bool lazy;              // Call-by-need evaluation
+};
+
+// Optional observers handed to the pipeline; NULL members are switched off
+struct Instruments {
+	Instruments() : stats(nullptr), profiler(nullptr), tracer(nullptr), heapProfiler(nullptr) {}
+
+	RunStats* stats;
+	LambdaProfiler* profiler;
+	ExecutionTracer* tracer;
+	HeapProfiler* heapProfiler;
+};
+
+void printUsage(const char* program){
+	cerr << "Usage: " << program << " [-ast] [-st] [--stats[=text|json]] [--stats-file=<path>]" << endl;
+	cerr << "       [--profile] [--profile-folded=<path>] [--max-steps=<n>] [--max-memory=<bytes>] [--hwcounters]" << endl;
+	cerr << "       [--trace=<path>] [--trace-sample=<n>] [--heap-profile] [--strict-bool] [--lazy] <filename>" << endl;
+	cerr << "  -ast: Display Abstract Syntax Tree" << endl;
+	cerr << "  -st:  Display Standardized Tree" << endl;
+	cerr << "  --stats:      Report per-phase timings and counters (text or json)" << endl;
+	cerr << "  --stats-file: Write the statistics report to a file instead of stderr" << endl;
+	cerr << "  --profile:    Report steps and time spent in each lambda" << endl;
+	cerr << "  --profile-folded: Write folded stacks for flamegraph tools" << endl;
+	cerr << "  --max-steps:  Stop evaluation after n machine steps (default unlimited)" << endl;
+	cerr << "  --max-memory: Stop evaluation once the machine holds more than this many bytes" << endl;
+	cerr << "  --hwcounters: Add CPU performance counters per phase to the statistics" << endl;
+	cerr << "  --trace:      Write a Chrome/Perfetto trace of phases, lambdas and builtins" << endl;
+	cerr << "  --trace-sample: Trace only every nth lambda application and builtin call" << endl;
+	cerr << "  --heap-profile: Report bytes allocated and live per creating lambda" << endl;
+	cerr << "  --strict-bool: Evaluate both operands of or and & instead of short-circuiting" << endl;
+	cerr << "  --lazy:       Evaluate arguments and let bindings only when first used" << endl;
+}
 
-		TreeNode* root = nullptr;
-		try {
-			root = parser->getTree();
-			if (!root) {
-				cerr << "Error: Parser returned null tree" << endl;
-				delete parser;
-				delete lexer;
+bool parseArguments(int argc, char* argv[], CommandLineOptions& options){
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "-ast") {
+			options.astSwitch = true;
+		} else if (arg == "-st") {
+			options.stSwitch = true;
+		} else if (arg == "--stats" || arg == "--stats=text") {
+			options.statsFormat = "text";
+		} else if (arg == "--stats=json") {
+			options.statsFormat = "json";
+		} else if (arg.compare(0, 13, "--stats-file=") == 0) {
+			options.statsFile = arg.substr(13);
+			if (options.statsFormat.empty())
+				options.statsFormat = "text";
+		} else if (arg == "--profile") {
+			options.profile = true;
+		} else if (arg.compare(0, 17, "--profile-folded=") == 0) {
+			options.foldedFile = arg.substr(17);
+		} else if (arg == "--hwcounters") {
+			options.hwCounters = true;
+			if (options.statsFormat.empty())
+				options.statsFormat = "text";
+		} else if (arg == "--heap-profile") {
+			options.heapProfile = true;
+		} else if (arg == "--strict-bool") {
+			options.strictBooleans = true;
+		} else if (arg == "--lazy") {
+			options.lazy = true;
+		} else if (arg.compare(0, 8, "--trace=") == 0) {
+			options.traceFile = arg.substr(8);
+		} else if (arg.compare(0, 15, "--trace-sample=") == 0) {
+			string value = arg.substr(15);
+			char* end = nullptr;
+			unsigned long interval = strtoul(value.c_str(), &end, 10);
+			if (value.empty() || *end != '\0' || value[0] == '-' || interval == 0 || interval > 0xFFFFFFFFUL) {
+				cerr << "Error: Invalid trace sampling interval '" << value << "'" << endl;
 				return false;
 			}
-		} catch (const exception& e) {
-			cerr << "Error: Failed to get parse tree - " << e.what() << endl;
-			delete parser;
-			delete lexer;
-			return false;
-		}
-
-		// AST Display (if requested)
-		if (ast_switch) {
-			try {
-				cout << "Abstract Syntax Tree:" << endl;
-				preOrder(root, "");
-				cout << endl;
-			} catch (const exception& e) {
-				cerr << "Error: Failed to display AST - " << e.what() << endl;
+			options.traceSample = interval;
+		} else if (arg.compare(0, 12, "--max-steps=") == 0) {
+			string value = arg.substr(12);
+			char* end = nullptr;
+			options.maxSteps = strtoull(value.c_str(), &end, 10);
+			if (value.empty() || *end != '\0' || value[0] == '-') {
+				cerr << "Error: Invalid step limit '" << value << "'" << endl;
+				return false;
 			}
-		}
-
-		// Standardization Phase
-		TreeNode* transformedRoot = nullptr;
-		try {
-			TreeStandardizer transformer;
-			transformedRoot = transformer.standardizeTree(root);
-
-			if (!transformedRoot) {
-				cerr << "Error: Tree standardization failed" << endl;
-				delete parser;
-				delete lexer;
+		} else if (arg.compare(0, 13, "--max-memory=") == 0) {
+			string value = arg.substr(13);
+			char* end = nullptr;
+			options.maxMemory = strtoull(value.c_str(), &end, 10);
+			if (value.empty() || *end != '\0' || value[0] == '-') {
+				cerr << "Error: Invalid memory limit '" << value << "'" << endl;
 				return false;
 			}
-		} catch (const std::exception& e) {
-			cerr << "Error: Standardization failed - " << e.what() << endl;
-			delete parser;
-			delete lexer;
+		} else if (arg.size() > 1 && arg[0] == '-') {
+			cerr << "Error: Unknown option '" << arg << "'" << endl;
+			return false;
+		} else if (options.fileName == nullptr) {
+			options.fileName = argv[i];
+		} else {
+			cerr << "Error: More than one input file given" << endl;
 			return false;
 		}
+	}
+	return options.fileName != nullptr;
+}
 
-		// Standardized Tree Display (if requested)
-		if (st_switch) {
-			try {
-				cout << "Standardized Tree:" << endl;
-				preOrder(transformedRoot, "");
-				cout << endl;
-			} catch (const exception& e) {
-				cerr << "Error: Failed to display standardized tree - " << e.what() << endl;
-			}
+// Statistics report - stderr by default, or the file named by --stats-file
+void writeStats(const RunStats& stats, const CommandLineOptions& options){
+	ofstream statsFile;
+	if (!options.statsFile.empty()) {
+		statsFile.open(options.statsFile.c_str());
+		if (statsFile.fail()) {
+			cerr << "Error: Could not open statistics file '" << options.statsFile << "'" << endl;
+			return;
 		}
+	}
+	ostream& out = options.statsFile.empty() ? cerr : statsFile;
+	if (options.statsFormat == "json")
+		stats.writeJson(out);
+	else
+		stats.writeText(out);
+}
 
-		// Evaluation Phase
-		if (evaluate_only || (!ast_switch && !st_switch)) {
-			try {
-				CSEMachine* machine = new CSEMachine(transformedRoot);
-				if (!machine) {
-					cerr << "Error: Failed to create CSE machine" << endl;
-					delete parser;
-					delete lexer;
-					return false;
-				}
-
-				machine->evaluateTree();
-				delete machine;
-			} catch (const exception& e) {
-				cerr << "Error: Evaluation failed - " << e.what() << endl;
-				cerr << "This could be due to runtime errors in your program." << endl;
-				delete parser;
-				delete lexer;
-				return false;
-			}
+// Lambda profile - table on stderr, folded stacks to the --profile-folded file
+void writeProfile(const LambdaProfiler& profiler, const CommandLineOptions& options){
+	if (options.profile)
+		profiler.writeTable(cerr);
+	if (!options.foldedFile.empty()) {
+		ofstream foldedFile(options.foldedFile.c_str());
+		if (foldedFile.fail()) {
+			cerr << "Error: Could not open folded stack file '" << options.foldedFile << "'" << endl;
+			return;
 		}
+		profiler.writeFolded(foldedFile);
+	}
+}
 
-		delete parser;
-		delete lexer;
-		return true;
+// Chrome trace-event file for --trace
+void writeTrace(const ExecutionTracer& tracer, const CommandLineOptions& options){
+	ofstream traceFile(options.traceFile.c_str());
+	if (traceFile.fail()) {
+		cerr << "Error: Could not open trace file '" << options.traceFile << "'" << endl;
+		return;
+	}
+	tracer.writeJson(traceFile);
+}
 
-	} catch (const bad_alloc& e) {
-		cerr << "Error: Memory allocation failed - " << e.what() << endl;
+// Reports a failed compile or run the way each phase always has
+void reportFailure(const Status& status){
+	switch (status.code) {
+	case Status::PARSE_ERROR:
+		cerr << "Error: Parsing failed - " << status.message << endl;
+		cerr << "Please check your program syntax." << endl;
+		break;
+	case Status::STANDARDIZE_ERROR:
+		cerr << "Error: Standardization failed - " << status.message << endl;
+		break;
+	case Status::RUNTIME_ERROR:
+	case Status::STEP_LIMIT:
+	case Status::MEMORY_LIMIT:
+		cerr << "Error: Evaluation failed - " << status.message << endl;
+		cerr << "This could be due to runtime errors in your program." << endl;
+		break;
+	case Status::OUT_OF_MEMORY:
+		cerr << "Error: Memory allocation failed - " << status.message << endl;
 		cerr << "The program may be too large or system is out of memory." << endl;
-		return false;
-	} catch (const exception& e) {
-		cerr << "Error: Unexpected exception during processing - " << e.what() << endl;
-		return false;
-	} catch (...) {
-		cerr << "Error: Unknown exception occurred during processing" << endl;
+		break;
+	default:
+		cerr << "Error: Unexpected exception during processing - " << status.message << endl;
+		break;
+	}
+}
+
+// Compiles the program, printing the trees -ast and -st ask for, and runs it when neither does
+bool safeParseAndProcess(const string& code_string, const CommandLineOptions& options, const Instruments& instruments) {
+	Program::Options compileOptions;
+	compileOptions.lazy = options.lazy;
+	compileOptions.strictBooleans = options.strictBooleans;
+	if (options.astSwitch)
+		compileOptions.astOutput = &cout;
+	if (options.stSwitch)
+		compileOptions.stOutput = &cout;
+
+	shared_ptr<const Program> program;
+	Status status = Program::compile(code_string, compileOptions, program, instruments.stats);
+	if (status.ok() && !options.astSwitch && !options.stSwitch) {
+		Execution execution(program);
+		execution.setStats(instruments.stats);
+		execution.setProfiler(instruments.profiler);
+		execution.setTracer(instruments.tracer);
+		execution.setHeapProfiler(instruments.heapProfiler);
+		execution.setStepLimit(options.maxSteps);
+		execution.setMemoryLimit(options.maxMemory);
+		status = execution.run();
+	}
+	if (!status.ok()) {
+		reportFailure(status);
 		return false;
 	}
+	return true;
 }
 
 int main(int argc,char *argv[]) {
 	try {
-		char* file_name = nullptr;
-		bool ast_switch = false;
-		bool st_switch = false;
-
-		if(argc == 4){
-			if(((string) argv[1]).compare("-st") == 0)
-				st_switch = true;
-			if(((string) argv[2]).compare("-ast") == 0)
-				ast_switch = true;
-			if(((string) argv[2]).compare("-st") == 0)
-				st_switch = true;
-			if(((string) argv[1]).compare("-ast") == 0)
-				ast_switch = true;
-			file_name = argv[3];
-		}
-		else if(argc == 3){
-			if(((string) argv[1]).compare("-ast") == 0)
-				ast_switch = true;
-			if(((string) argv[1]).compare("-st") == 0)
-				st_switch = true;
-			file_name = argv[2];
-		}
-		else if(argc == 2){
-			file_name = argv[1];
-		}
-		else {
-			cerr << "Usage: " << argv[0] << " [-ast] [-st] <filename>" << endl;
-			cerr << "  -ast: Display Abstract Syntax Tree" << endl;
-			cerr << "  -st:  Display Standardized Tree" << endl;
+		CommandLineOptions options;
+		if (!parseArguments(argc, argv, options)) {
+			printUsage(argv[0]);
 			return 1;
 		}
+		char* file_name = options.fileName;
 
 		if (!file_name || strlen(file_name) == 0) {
 			cerr << "Error: No filename provided or filename is empty" << endl;
 			return 1;
 		}
 
+		RunStats runStats;
+		// Tracing needs the phase timers even without a statistics report
+		bool tracing = !options.traceFile.empty();
+		RunStats* stats = options.statsFormat.empty() && !tracing ? nullptr : &runStats;
+		HardwareCounters hardwareCounters;
+		if (options.hwCounters) {
+			hardwareCounters.open();
+			runStats.hardwareCounters = &hardwareCounters;
+		}
+		LambdaProfiler profiler;
+		Instruments instruments;
+		instruments.stats = stats;
+		if (options.profile || !options.foldedFile.empty())
+			instruments.profiler = &profiler;
+		ExecutionTracer tracer(tracing ? 1 << 18 : 1, options.traceSample);
+		if (tracing) {
+			runStats.tracer = &tracer;
+			instruments.tracer = &tracer;
+		}
+		HeapProfiler heapProfiler;
+		if (options.heapProfile)
+			instruments.heapProfiler = &heapProfiler;
+
 		string code_string;
 		try {
+			PhaseTimer timer(stats, RunStats::FILE_LOAD);
 			code_string = openFile(file_name);
 		} catch (const exception& e) {
 			cerr << "Error: Exception while opening file - " << e.what() << endl;
@@ -245,11 +337,19 @@ int main(int argc,char *argv[]) {
 			return 1;
 		}
 
-		bool success = false;
-		if (argc == 2) {
-			success = safeParseAndProcess(code_string, false, false, true);
-		} else {
-			success = safeParseAndProcess(code_string, ast_switch, st_switch, false);
+		bool success = safeParseAndProcess(code_string, options, instruments);
+
+		if (!options.statsFormat.empty()) {
+			stats->capturePeakRss();
+			writeStats(*stats, options);
+		}
+		if (instruments.profiler)
+			writeProfile(profiler, options);
+		if (instruments.heapProfiler)
+			heapProfiler.writeTable(cerr);
+		if (tracing) {
+			tracer.finish();
+			writeTrace(tracer, options);
 		}
 
 		if (!success) {
@@ -267,53 +367,3 @@ int main(int argc,char *argv[]) {
 		return 1;
 	}
 }
-
-void preOrder(TreeNode* t, std::string dots){
-	if (t == nullptr) {
-		cout << dots << "[NULL]" << endl;
-		return;
-	}
-
-	try {
-		formattedPrint(t->value, dots);
-		string dots1 = "." + dots;
-
-		if(t->left != nullptr) {
-			try {
-				preOrder(t->left, dots1);
-			} catch (...) {
-				cerr << "Error in left subtree traversal" << endl;
-			}
-		}
-		if(t->right != nullptr) {
-			try {
-				preOrder(t->right, dots);
-			} catch (...) {
-				cerr << "Error in right subtree traversal" << endl;
-			}
-		}
-	} catch (const exception& e) {
-		cerr << "Error in preOrder traversal: " << e.what() << endl;
-	}
-}
-
-void formattedPrint(Token t, std::string dots){
-	try {
-		if(t.type == "IDENTIFIER"){
-			cout << dots << "<ID:" << t.value << '>' << endl;
-		} else if(t.type == "INTEGER"){
-			cout << dots << "<INT:" << t.value << '>' << endl;
-		} else if(t.type == "STRING"){
-			cout << dots << "<STR:" << t.value << '>' << endl;
-		} else if(t.value == "true" || t.value == "false" || t.value == "nil" || t.value == "dummy"){
-			cout << dots << '<' << t.value << '>' << endl;
-		} else if(t.value == "YSTAR"){
-			cout << dots << "<Y*>" << endl;
-		} else {
-			cout << dots << t.value << endl;
-		}
-	} catch (const exception& e) {
-		cerr << "Error in formattedPrint: " << e.what() << endl;
-		cout << dots << "[ERROR_PRINTING_TOKEN]" << endl;
-	}
-}
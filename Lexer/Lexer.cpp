@@ -23,6 +23,7 @@ Lexer::Lexer(string inputString) {
     this->size = inputString.size();
     this->currentPosition = 0;
     this->tokenPointer = 0;
+    this->lineNumber = 1;
     this->hasRemainingTokens = true;
     this->additionalTokensExist = true;
     convertStringToTokens();
@@ -190,6 +191,8 @@ Token Lexer::processStringLiteral(char c) {
             t.type = "STRING";
             t.value += c;
             break;
+        } else if(c == '\n') {
+            lineNumber++;
         } else if(c == '\\') {
             char nextc = inputString.at(currentPosition++);
             if(isEscapeSequence(nextc)) {
@@ -239,13 +242,16 @@ Token Lexer::processAlphabeticToken(char c) {
 void Lexer::convertStringToTokens() {
     while(currentPosition < size) {
         Token token;
+        int tokenLine = lineNumber;
         
         char c = inputString.at(currentPosition++);
 
         switch(c) {
             case ' ':
             case '\t':
+                continue;
             case '\n':
+                lineNumber++;
                 continue;
             case '(':
             case ')':
@@ -266,6 +272,7 @@ void Lexer::convertStringToTokens() {
                 }
                 break;
         }
+        token.line = tokenLine;
         tokens.push_back(token);
     }
 }
@@ -292,6 +299,14 @@ Token Lexer::previewNextToken() {
     return t;
 }
 
+/**
+ * Token access method - number of tokens produced by the tokenizer
+ * @return total token count
+ */
+size_t Lexer::tokenCount() const {
+    return tokens.size();
+}
+
 /**
  * Static token type identifiers for external reference
  */
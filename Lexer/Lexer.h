@@ -33,6 +33,7 @@ private:
     int size;
     int currentPosition;
     int tokenPointer;
+    int lineNumber;
     vector<Token> tokens;
     bool hasRemainingTokens;
     bool additionalTokensExist;
@@ -73,6 +74,7 @@ public:
      */
     Token retrieveNextToken();
     Token previewNextToken();
+    size_t tokenCount() const;
     
     /**
      * Character classification methods
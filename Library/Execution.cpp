@@ -0,0 +1,69 @@
+/**
+ * Execution Implementation
+ */
+
+#include "Execution.h"
+#include <iostream>
+#include <new>
+#include <stdexcept>
+
+using namespace std;
+
+Execution::Execution(shared_ptr<const Program> program)
+	: program(program), output(&cout), maxSteps(0), maxMemory(0), stats(NULL), profiler(NULL), tracer(NULL),
+	  heapProfiler(NULL), stepCount(0), peakMemory(0) {
+}
+
+void Execution::setOutput(ostream* output){
+	this->output = output;
+}
+
+void Execution::setStepLimit(unsigned long long maxSteps){
+	this->maxSteps = maxSteps;
+}
+
+void Execution::setMemoryLimit(unsigned long long maxBytes){
+	this->maxMemory = maxBytes;
+}
+
+void Execution::setStats(RunStats* stats){
+	this->stats = stats;
+}
+
+void Execution::setProfiler(LambdaProfiler* profiler){
+	this->profiler = profiler;
+}
+
+void Execution::setTracer(ExecutionTracer* tracer){
+	this->tracer = tracer;
+}
+
+void Execution::setHeapProfiler(HeapProfiler* heapProfiler){
+	this->heapProfiler = heapProfiler;
+}
+
+Status Execution::run(){
+	stepCount = 0;
+	peakMemory = 0;
+	CSEMachine machine(program->controlStructures());
+	machine.setOutput(output);
+	machine.setStats(stats);
+	machine.setProfiler(profiler);
+	machine.setTracer(tracer);
+	machine.setHeapProfiler(heapProfiler);
+	machine.setStepLimit(maxSteps);
+	machine.setMemoryLimit(maxMemory);
+	Status status;
+	try {
+		machine.evaluateTree();
+	} catch (const EvaluationLimit& e) {
+		status = Status(e.kind == EvaluationLimit::STEPS ? Status::STEP_LIMIT : Status::MEMORY_LIMIT, e.what());
+	} catch (const bad_alloc& e) {
+		status = Status(Status::OUT_OF_MEMORY, e.what());
+	} catch (const exception& e) {
+		status = Status(Status::RUNTIME_ERROR, e.what());
+	}
+	stepCount = machine.stepsTaken();
+	peakMemory = machine.peakBytes();
+	return status;
+}
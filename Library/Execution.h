@@ -0,0 +1,54 @@
+/**
+ * Execution Header
+ *
+ * One run of a compiled Program, and what it is allowed to use: where Print
+ * writes, how many machine steps and how much machine memory it may take,
+ * and which observers watch it. Each run gets a machine of its own over the
+ * program's shared control structures, so Executions of one Program may run
+ * on different threads; the observers and the output sink belong to the
+ * Execution and must not be shared between concurrent runs.
+ */
+
+#ifndef EXECUTION_H_
+#define EXECUTION_H_
+
+#include <memory>
+#include <ostream>
+#include "Program.h"
+#include "RunStats.h"
+#include "LambdaProfiler.h"
+#include "ExecutionTracer.h"
+#include "HeapProfiler.h"
+
+class Execution {
+public:
+	explicit Execution(std::shared_ptr<const Program> program);
+
+	void setOutput(std::ostream* output);                  // Print's sink; std::cout by default
+	void setStepLimit(unsigned long long maxSteps);        // 0, the default, is unlimited
+	void setMemoryLimit(unsigned long long maxBytes);      // Machine memory as CSEMachine estimates it; 0 is unlimited
+	void setStats(RunStats* stats);
+	void setProfiler(LambdaProfiler* profiler);
+	void setTracer(ExecutionTracer* tracer);
+	void setHeapProfiler(HeapProfiler* heapProfiler);
+
+	Status run();                                          // May be called again for a fresh run
+
+	// Of the latest run, however it ended
+	unsigned long long steps() const { return stepCount; }
+	unsigned long long peakBytes() const { return peakMemory; }  // Tracked only under a memory limit
+
+private:
+	std::shared_ptr<const Program> program;
+	std::ostream* output;
+	unsigned long long maxSteps;
+	unsigned long long maxMemory;
+	RunStats* stats;
+	LambdaProfiler* profiler;
+	ExecutionTracer* tracer;
+	HeapProfiler* heapProfiler;
+	unsigned long long stepCount;
+	unsigned long long peakMemory;
+};
+
+#endif /* EXECUTION_H_ */
@@ -0,0 +1,165 @@
+/**
+ * Program Implementation
+ *
+ * The front end runs as the command line interpreter always ran it, each
+ * phase timed into the caller's statistics. The tree arena lives only for
+ * the compile: the control structures hold copies of the tokens they need.
+ */
+
+#include "Program.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "Standardizer.h"
+#include "TreeArena.h"
+#include "TreeNode.h"
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Number of nodes reachable from a tree root
+static unsigned long long countTreeNodes(TreeNode* root){
+	unsigned long long count = 0;
+	vector<TreeNode*> pending;
+	if (root != nullptr)
+		pending.push_back(root);
+	while (!pending.empty()) {
+		TreeNode* node = pending.back();
+		pending.pop_back();
+		count++;
+		if (node->right != nullptr)
+			pending.push_back(node->right);
+		if (node->left != nullptr)
+			pending.push_back(node->left);
+	}
+	return count;
+}
+
+static void formattedPrint(const Token& t, const string& dots, string& out){
+	out += dots;
+	if(t.type == "IDENTIFIER"){
+		out.append("<ID:").append(t.value) += '>';
+	} else if(t.type == "INTEGER"){
+		out.append("<INT:").append(t.value) += '>';
+	} else if(t.type == "STRING"){
+		out.append("<STR:").append(t.value) += '>';
+	} else if(t.value == "true" || t.value == "false" || t.value == "nil" || t.value == "dummy"){
+		out.append("<").append(t.value) += '>';
+	} else if(t.value == "YSTAR"){
+		out += "<Y*>";
+	} else {
+		out += t.value;
+	}
+	out += '\n';
+}
+
+// Iterative pre-order printer - pending nodes and their depth live on an explicit
+// stack, one indentation buffer is resized per line, and output is written in chunks
+static void preOrder(TreeNode* t, const TreeArena& arena, ostream& output){
+	if (t == nullptr) {
+		output << "[NULL]" << endl;
+		return;
+	}
+
+	const size_t flushThreshold = 1 << 16;
+	vector<pair<TreeNode*, size_t> > pending;
+	string dots;
+	string out;
+	pending.push_back(make_pair(t, (size_t)0));
+
+	while(!pending.empty()) {
+		TreeNode* node = pending.back().first;
+		size_t depth = pending.back().second;
+		pending.pop_back();
+
+		dots.resize(depth, '.');
+		formattedPrint(arena.token(node), dots, out);
+		if(out.size() >= flushThreshold) {
+			output.write(out.data(), out.size());
+			out.clear();
+		}
+
+		if(node->right != nullptr)
+			pending.push_back(make_pair(node->right, depth));
+		if(node->left != nullptr)
+			pending.push_back(make_pair(node->left, depth + 1));
+	}
+	output.write(out.data(), out.size());
+	output.flush();
+}
+
+// A tree under its heading, as -ast and -st print it
+static void printTree(const char* heading, TreeNode* root, const TreeArena& arena, ostream& output){
+	output << heading << endl;
+	preOrder(root, arena, output);
+	output << endl;
+}
+
+Status Program::compile(const string& source, const Options& options, shared_ptr<const Program>& program, RunStats* stats){
+	program.reset();
+	try {
+		// Lexical Analysis Phase
+		unique_ptr<Lexer> lexer;
+		try {
+			PhaseTimer timer(stats, RunStats::LEX);
+			lexer.reset(new Lexer(source));
+		} catch (const bad_alloc&) {
+			throw;
+		} catch (const exception& e) {
+			return Status(Status::LEX_ERROR, e.what());
+		}
+		STATS_ADD(stats, tokenCount, lexer->tokenCount());
+
+		// Parsing Phase - every tree node lives in the arena and is released with it
+		TreeArena arena;
+		Parser parser(lexer.get(), &arena);
+		TreeNode* root = nullptr;
+		try {
+			PhaseTimer timer(stats, RunStats::PARSE);
+			parser.parse();
+			root = parser.getTree();
+		} catch (const bad_alloc&) {
+			throw;
+		} catch (const exception& e) {
+			return Status(Status::PARSE_ERROR, e.what());
+		}
+		if (!root)
+			return Status(Status::PARSE_ERROR, "parser returned null tree");
+		STATS_ADD(stats, astNodeCount, arena.nodeCount());
+		if (options.astOutput)
+			printTree("Abstract Syntax Tree:", root, arena, *options.astOutput);
+
+		// Standardization Phase
+		TreeNode* transformedRoot = nullptr;
+		try {
+			PhaseTimer timer(stats, RunStats::STANDARDIZE);
+			TreeStandardizer transformer(&arena);
+			transformedRoot = transformer.standardizeTree(root);
+		} catch (const bad_alloc&) {
+			throw;
+		} catch (const exception& e) {
+			return Status(Status::STANDARDIZE_ERROR, e.what());
+		}
+		if (!transformedRoot)
+			return Status(Status::STANDARDIZE_ERROR, "tree standardization failed");
+		if (stats)
+			stats->stNodeCount = countTreeNodes(transformedRoot);
+		if (options.stOutput)
+			printTree("Standardized Tree:", transformedRoot, arena, *options.stOutput);
+
+		// Control structures - building them rewrites the tree, so it is not kept
+		CSEMachine compiler(transformedRoot, &arena);
+		compiler.setStats(stats);
+		compiler.setStrictBooleans(options.strictBooleans);
+		compiler.setLazy(options.lazy);
+		program.reset(new Program(compiler.compile()));
+		return Status();
+
+	} catch (const bad_alloc& e) {
+		return Status(Status::OUT_OF_MEMORY, e.what());
+	} catch (const exception& e) {
+		return Status(Status::RUNTIME_ERROR, e.what());
+	}
+}
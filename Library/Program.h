@@ -0,0 +1,69 @@
+/**
+ * Program Header
+ *
+ * The interpreter as a library. A Program is RPAL source compiled once -
+ * lexed, parsed, standardized and turned into the machine's control
+ * structures - and kept as those control structures alone. It is immutable
+ * after compile, so one Program can be run by any number of Executions,
+ * one after another or on several threads at once. Nothing here writes to
+ * the standard streams or exits; every failure comes back as a Status.
+ */
+
+#ifndef PROGRAM_H_
+#define PROGRAM_H_
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include "CSEMachine.h"
+#include "RunStats.h"
+
+// Outcome of compiling or running a program; message is empty on success
+struct Status {
+	enum Code {
+		OK,
+		LEX_ERROR,
+		PARSE_ERROR,
+		STANDARDIZE_ERROR,
+		RUNTIME_ERROR,          // The program failed: a type error, a division by zero...
+		STEP_LIMIT,
+		MEMORY_LIMIT,
+		OUT_OF_MEMORY           // An allocation failed
+	};
+
+	Status() : code(OK) {}
+	Status(Code code, const std::string& message) : code(code), message(message) {}
+	bool ok() const { return code == OK; }
+
+	Code code;
+	std::string message;
+};
+
+class Program {
+public:
+	// Choices made at compile time, since the control structures depend on them
+	struct Options {
+		Options() : lazy(false), strictBooleans(false), astOutput(NULL), stOutput(NULL) {}
+
+		bool lazy;                      // Call-by-need evaluation
+		bool strictBooleans;            // Evaluate both operands of or and &
+		std::ostream* astOutput;        // Where to print the abstract syntax tree, as -ast does; NULL for nowhere
+		std::ostream* stOutput;         // Where to print the standardized tree, as -st does; NULL for nowhere
+	};
+
+	/**
+	 * Compiles source into program. Phase times and front-end counters go to
+	 * stats when it is not NULL. On failure program is left NULL
+	 */
+	static Status compile(const std::string& source, const Options& options, std::shared_ptr<const Program>& program,
+			RunStats* stats = NULL);
+
+	std::shared_ptr<const ControlStructures> controlStructures() const { return code; }
+
+private:
+	explicit Program(std::shared_ptr<const ControlStructures> code) : code(code) {}
+
+	std::shared_ptr<const ControlStructures> code;
+};
+
+#endif /* PROGRAM_H_ */
@@ -0,0 +1,124 @@
+/**
+  Tree Node Arena
+
+  The arena owns every node and token of a syntax tree. Nodes are handed out
+  from fixed-size blocks, so they stay at a stable address while the parser and
+  standardizer rewire links, and neighbouring nodes sit next to each other in
+  memory. Tokens are interned once in a table and nodes refer to them by a
+  32-bit id, so structural tokens such as gamma and lambda are shared instead of
+  copied into every node. Releasing the arena frees the whole tree at once,
+  without walking it.
+ */
+
+#include "TreeArena.h"
+#include <sstream>
+
+using namespace std;
+
+TreeArena::TreeArena() {
+	blockUsed = BLOCK_SIZE;             // Forces a block allocation on the first node
+}
+
+TreeArena::~TreeArena() {
+	release();
+}
+
+/**
+ * Node factory - interns the token and returns a node referring to it
+ */
+TreeNode* TreeArena::createNode(const Token& token) {
+	return createNode(internToken(token));
+}
+
+/**
+ * Node factory - bumps the next node out of the current block
+ * A new block is started when the current one is full
+ */
+TreeNode* TreeArena::createNode(unsigned int tokenId) {
+	if(blockUsed == BLOCK_SIZE) {
+		blocks.push_back(new TreeNode[BLOCK_SIZE]);
+		blockUsed = 0;
+	}
+	TreeNode* node = &blocks.back()[blockUsed++];
+	node->tokenId = tokenId;
+	return node;
+}
+
+/**
+ * Token interning - returns the id of an equal token, adding it on first use
+ * Two tokens are equal when their type and value match; tau tokens also
+ * compare their element count and identifiers their source line
+ */
+unsigned int TreeArena::internToken(const Token& token) {
+	string key = internKey(token);
+	unordered_map<string, unsigned int>::iterator it = tokenIds.find(key);
+	if(it != tokenIds.end())
+		return it->second;
+
+	unsigned int tokenId = tokens.size();
+	tokens.push_back(token);
+	tokenIds[key] = tokenId;
+	return tokenId;
+}
+
+/**
+ * Token lookup by id
+ */
+const Token& TreeArena::token(unsigned int tokenId) const {
+	return tokens[tokenId];
+}
+
+/**
+ * Token lookup for a node
+ */
+const Token& TreeArena::token(const TreeNode* node) const {
+	return tokens[node->tokenId];
+}
+
+size_t TreeArena::nodeCount() const {
+	if(blocks.empty())
+		return 0;
+	return (blocks.size() - 1) * BLOCK_SIZE + blockUsed;
+}
+
+size_t TreeArena::tokenCount() const {
+	return tokens.size();
+}
+
+size_t TreeArena::bytesReserved() const {
+	return blocks.size() * BLOCK_SIZE * sizeof(TreeNode) + tokens.size() * sizeof(Token);
+}
+
+/**
+ * Whole-tree release - frees every block and the token table at once
+ * Node pointers and token ids handed out earlier become invalid
+ */
+void TreeArena::release() {
+	for(unsigned int i = 0; i < blocks.size(); i++)
+		delete[] blocks[i];
+	blocks.clear();
+	blockUsed = BLOCK_SIZE;
+	tokens.clear();
+	tokenIds.clear();
+}
+
+/**
+ * Interning key - type and value separated by a character that cannot
+ * appear in either; tau tokens append their element count and identifiers
+ * their source line, so lambda parameters keep the line they were written on
+ */
+string TreeArena::internKey(const Token& token) const {
+	string key = token.type;
+	key += '\x1f';
+	key += token.value;
+	if(token.type == "tau") {
+		ostringstream oss;
+		oss << '\x1f' << token.tauCount;
+		key += oss.str();
+	} else if(token.type == "IDENTIFIER" && token.line != 0) {
+		ostringstream oss;
+		oss << '\x1f' << token.line;
+		key += oss.str();
+	}
+	return key;
+}
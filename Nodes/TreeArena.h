@@ -0,0 +1,52 @@
+/**
+  Tree Node Arena
+
+  The arena owns every node and token of a syntax tree. Nodes are handed out
+  from fixed-size blocks, so they stay at a stable address while the parser and
+  standardizer rewire links, and neighbouring nodes sit next to each other in
+  memory. Tokens are interned once in a table and nodes refer to them by a
+  32-bit id, so structural tokens such as gamma and lambda are shared instead of
+  copied into every node. Releasing the arena frees the whole tree at once,
+  without walking it.
+ */
+
+#ifndef TREEARENA_H_
+#define TREEARENA_H_
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Token.h"
+#include "TreeNode.h"
+
+class TreeArena {
+public:
+	TreeArena();
+	virtual ~TreeArena();
+
+	TreeNode* createNode(const Token& token);       // Interns the token and returns a fresh node
+	TreeNode* createNode(unsigned int tokenId);     // Returns a fresh node sharing an interned token
+	unsigned int internToken(const Token& token);   // Returns the id of an equal token, adding it if new
+
+	const Token& token(unsigned int tokenId) const; // Token lookup by id
+	const Token& token(const TreeNode* node) const; // Token of the given node
+
+	size_t nodeCount() const;                       // Nodes handed out since the last release
+	size_t tokenCount() const;                      // Distinct tokens in the table
+	size_t bytesReserved() const;                   // Memory held by blocks and the token table
+
+	void release();                                 // Frees every node and token in one go
+
+private:
+	static const size_t BLOCK_SIZE = 4096;          // Nodes per block
+
+	std::vector<TreeNode*> blocks;                  // Fixed-size node blocks, never moved
+	size_t blockUsed;                               // Nodes used in the last block
+	std::deque<Token> tokens;                       // Token table - deque keeps references stable
+	std::unordered_map<std::string, unsigned int> tokenIds; // Interning index keyed by type and value
+
+	std::string internKey(const Token& token) const;
+};
+
+#endif /* TREEARENA_H_ */
@@ -1,10 +1,11 @@
 /**
   Binary Tree Node Implementation
-  
-  This code implements a generic tree node structure for building binary trees.
-  Each node contains a Token value and pointers to left and right children, along with
-  a next pointer for potential linking operations. The implementation provides proper
-  memory management through recursive deletion of child nodes.
+
+  This code implements a compact tree node structure for building binary trees.
+  Each node refers to its Token by a 32-bit id into the owning TreeArena's token
+  table and holds pointers to its left child and right sibling. Nodes are carved
+  out of arena blocks, so they are never deleted one by one: the arena releases
+  the whole tree in a single operation.
  */
 
 #ifndef TREENODE_H_
@@ -14,17 +15,11 @@
 
 class TreeNode {
 public:
-	TreeNode(Token token);              // Parameterized constructor - creates node with given token
 	TreeNode();                         // Default constructor - creates empty node
-	virtual ~TreeNode();                // Destructor - handles recursive cleanup of child nodes
-	
-	Token value;                        // Node data - contains the token value
+
+	unsigned int tokenId;               // Node data - id of the token in the arena's token table
 	TreeNode* right;                    // Right child pointer - points to right subtree
 	TreeNode* left;                     // Left child pointer - points to left subtree
-	TreeNode* next;                     // Next node pointer - for linking operations
-	
-private:
-	void cleanupNode(TreeNode* node);   // Memory cleanup helper - safely deletes node if not null
 };
 
-#endif /* TREENODE_H_ */
\ No newline at end of file
+#endif /* TREENODE_H_ */
@@ -4,6 +4,8 @@
  * It processes tokens from a lexical analyzer and constructs an Abstract Syntax Tree (AST)
  * using a stack-based approach, following grammar rules for expressions, declarations,
  * and various language constructs like let-expressions, functions, and conditionals.
+ * Operator expressions (aug down to function application) are parsed by precedence
+ * climbing over a compile-time operator table instead of one function per level.
  */
 
 #include <iostream>
@@ -11,6 +13,9 @@
 #include "Token.h"
 #include <string>
 #include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
 
 using namespace std;
 
@@ -20,9 +25,80 @@ string Parser::INT = "INTEGER";
 string Parser::KEY = "KEYWORD";
 string Parser::OPT = "OPERATOR";
 
-Parser::Parser(Lexer* analyzer) {
+/**
+ * Operator table - binding power and shape of every infix operator
+ * Higher precedence binds tighter; function application binds tightest of all
+ * and is handled by processRationalExpression
+ */
+enum OperatorShape {
+    LEFT_ASSOCIATIVE,       // a op b op c  =>  (a op b) op c
+    RIGHT_ASSOCIATIVE,      // a op b op c  =>  a op (b op c)
+    NON_ASSOCIATIVE,        // a op b - a second operator of the same level is not consumed
+    CONDITIONAL,            // B -> T | T
+    AT_APPLICATION          // a @ f b
+};
+
+struct OperatorInfo {
+    const char* lexeme;     // Token value as produced by the lexer
+    const char* nodeValue;  // Value of the AST node built for it
+    const char* nodeType;   // Type of the AST node built for it
+    int precedence;
+    OperatorShape shape;
+};
+
+static const int AUG_PRECEDENCE = 1;
+static const int NOT_PRECEDENCE = 5;
+static const int ADDITIVE_PRECEDENCE = 7;
+
+static constexpr OperatorInfo operatorTable[] = {
+    { "aug", "aug", "KEYWORD",  AUG_PRECEDENCE, LEFT_ASSOCIATIVE },
+    { "->",  "->",  "->",       2,  CONDITIONAL },
+    { "or",  "or",  "OPERATOR", 3,  LEFT_ASSOCIATIVE },
+    { "&",   "&",   "OPERATOR", 4,  LEFT_ASSOCIATIVE },
+    { "gr",  "gr",  "OPERATOR", 6,  NON_ASSOCIATIVE },
+    { ">",   "gr",  "OPERATOR", 6,  NON_ASSOCIATIVE },
+    { "ge",  "ge",  "OPERATOR", 6,  NON_ASSOCIATIVE },
+    { ">=",  "ge",  "OPERATOR", 6,  NON_ASSOCIATIVE },
+    { "ls",  "ls",  "OPERATOR", 6,  NON_ASSOCIATIVE },
+    { "<",   "ls",  "OPERATOR", 6,  NON_ASSOCIATIVE },
+    { "le",  "le",  "OPERATOR", 6,  NON_ASSOCIATIVE },
+    { "<=",  "le",  "OPERATOR", 6,  NON_ASSOCIATIVE },
+    { "eq",  "eq",  "OPERATOR", 6,  NON_ASSOCIATIVE },
+    { "ne",  "ne",  "OPERATOR", 6,  NON_ASSOCIATIVE },
+    { "+",   "+",   "OPERATOR", ADDITIVE_PRECEDENCE, LEFT_ASSOCIATIVE },
+    { "-",   "-",   "OPERATOR", ADDITIVE_PRECEDENCE, LEFT_ASSOCIATIVE },
+    { "*",   "*",   "OPERATOR", 8,  LEFT_ASSOCIATIVE },
+    { "/",   "/",   "OPERATOR", 8,  LEFT_ASSOCIATIVE },
+    { "**",  "**",  "OPERATOR", 9,  RIGHT_ASSOCIATIVE },
+    { "@",   "@",   "OPERATOR", 10, AT_APPLICATION }
+};
+
+static const int operatorCount = sizeof(operatorTable) / sizeof(operatorTable[0]);
+static const int HIGHEST_PRECEDENCE = 10;
+
+/**
+ * Operator lookup - returns the table index for a token value, or -1
+ */
+static int findOperator(const string& value) {
+    if(value.empty())
+        return -1;
+    for(int i = 0; i < operatorCount; i++) {
+        if(operatorTable[i].lexeme[0] == value[0] && strcmp(operatorTable[i].lexeme, value.c_str()) == 0)
+            return i;
+    }
+    return -1;
+}
+
+Parser::Parser(Lexer* analyzer, TreeArena* arena) {
     this->lexer = analyzer;
+    this->arena = arena;
     this->tokensLeft = true;
+    this->gammaTokenId = arena->internToken(Token("gamma", "gamma"));
+    this->negTokenId = arena->internToken(Token("neg", "neg"));
+    this->notTokenId = arena->internToken(Token("not", "not"));
+    this->conditionalTokenId = arena->internToken(Token("->", "->"));
+    for(int i = 0; i < operatorCount; i++)
+        operatorTokenIds.push_back(arena->internToken(Token(operatorTable[i].nodeValue, operatorTable[i].nodeType)));
 }
 
 Parser::~Parser() {
@@ -41,9 +117,9 @@ void Parser::parse() {
  * Token matching and consumption utility - validates expected tokens
  * Reads the current token, builds tree nodes for terminals, and advances to next token
  */
-void Parser::consumeToken(Token token) {
+void Parser::consumeToken(const Token& token) {
     if(token.value != nextToken.value)
-        exit(1);
+        throwSyntaxError("'" + token.value + "'");
 
     switch(token.type[0]) {
         case 'I': // INTEGER or IDENTIFIER
@@ -66,11 +142,10 @@ void Parser::consumeToken(Token token) {
 
 /**
  * AST node construction utility - creates tree nodes and manages stack operations
- * Builds tree nodes with specified number of children popped from the stack
+ * Builds arena nodes with specified number of children popped from the stack
  */
-void Parser::constructTreeNode(Token tokenVal, int popTreeCnt) {
-    TreeNode* tempNode = new TreeNode;
-    tempNode->value = tokenVal;
+void Parser::constructTreeNode(const Token& tokenVal, int popTreeCnt) {
+    TreeNode* tempNode = arena->createNode(tokenVal);
     
     if(popTreeCnt != 0) {
         while(!stk.empty() && popTreeCnt > 1) {
@@ -88,6 +163,13 @@ void Parser::constructTreeNode(Token tokenVal, int popTreeCnt) {
     return;
 }
 
+/**
+ * AST node construction utility - same as above for an already interned token
+ */
+void Parser::constructTreeNode(unsigned int tokenId, int popTreeCnt) {
+    constructTreeNode(arena->token(tokenId), popTreeCnt);
+}
+
 /**
  * Tree structure utility - attaches nodes as right children
  * Manages the right child attachment during tree construction
@@ -151,12 +233,12 @@ void Parser::processWhereExpression() {
  * Processes expressions that can form tuples with tau operator
  */
 void Parser::processTupleExpression() {
-    processAugmentExpression();
+    processOperatorExpression(AUG_PRECEDENCE);
     if(nextToken.value == ",") {
         int n = 0;
         do {
             consumeToken(nextToken);
-            processAugmentExpression();
+            processOperatorExpression(AUG_PRECEDENCE);
             n++;
         } while(nextToken.value == ",");
         Token tauToken("tau", "tau");
@@ -166,216 +248,84 @@ void Parser::processTupleExpression() {
 }
 
 /**
- * Augment expression parser - handles augmentation operations
- * Processes expressions with augment operator (aug)
- */
-void Parser::processAugmentExpression() {
-    processConditionalExpression();
-    while(nextToken.value == "aug") {
-        Token temp = nextToken;
-        consumeToken(nextToken);
-        processConditionalExpression();
-        constructTreeNode(temp, 2);
-    }
-}
-
-/**
- * Conditional expression parser - handles conditional statements
- * Processes if-then-else style conditional expressions
- */
-void Parser::processConditionalExpression() {
-    processBooleanExpression();
-    if(nextToken.value == "->") {
-        consumeToken(nextToken);
-        processConditionalExpression();
-        Token elseToken("|", OPT);
-        consumeToken(elseToken);
-        processConditionalExpression();
-        Token nodeToken("->", "->");
-        constructTreeNode(nodeToken, 3);
-    }
-}
-
-/**
- * Boolean expression parser - handles logical OR operations
- * Processes boolean expressions with OR operator
- */
-void Parser::processBooleanExpression() {
-    processBooleanTerm();
-    while(nextToken.value == "or") {
-        nextToken.type = Parser::OPT;
-        Token temp = nextToken;
-        consumeToken(nextToken);
-        processBooleanTerm();
-        constructTreeNode(temp, 2);
-    }
-}
-
-/**
- * Boolean term parser - handles logical AND operations
- * Processes boolean terms with AND operator
+ * Operator expression parser - precedence climbing over operatorTable
+ * Parses an operand, then keeps folding in operators that bind at least as
+ * tightly as minPrecedence. Covers everything from aug down to function application.
+ * Returns the highest precedence an operator following the expression may have:
+ * below that of the last comparison or conditional parsed, at any depth, so
+ * the caller cannot chain another one onto it
  */
-void Parser::processBooleanTerm() {
-    processBooleanStatement();
-    while(nextToken.value == "&") {
-        nextToken.type = Parser::OPT;
-        Token temp = nextToken;
-        consumeToken(nextToken);
-        processBooleanStatement();
-        constructTreeNode(temp, 2);
-    }
-}
-
-/**
- * Boolean statement parser - handles NOT operations
- * Processes boolean statements with NOT operator
- */
-void Parser::processBooleanStatement() {
-    if(nextToken.value == "not") {
-        nextToken.type = "not";
-        Token temp = nextToken;
-        consumeToken(nextToken);
-        processBooleanPrimary();
-        constructTreeNode(temp, 1);
-    } else {
-        processBooleanPrimary();
-    }
-}
-
-/**
- * Boolean primary parser - handles comparison operations
- * Processes comparison operators like greater than, less than, equal, etc.
- */
-void Parser::processBooleanPrimary() {
-    processArithmeticExpression();
+int Parser::processOperatorExpression(int minPrecedence) {
+    int maxPrecedence = processPrefixExpression(minPrecedence);
     
-    switch(nextToken.value[0]) {
-        case 'g':
-            if(nextToken.value == "gr" || nextToken.value == ">=") {
-                nextToken.type = Parser::OPT;
-                processComparisonHelper(nextToken, nextToken.value == "gr" ? "gr" : "ge");
-            }
+    while(true) {
+        int index = findOperator(nextToken.value);
+        if(index < 0)
             break;
-        case 'l':
-            if(nextToken.value == "ls" || nextToken.value == "<=") {
-                nextToken.type = Parser::OPT;
-                processComparisonHelper(nextToken, nextToken.value == "ls" ? "ls" : "le");
-            }
-            break;
-        case 'e':
-            if(nextToken.value == "eq") {
-                nextToken.type = Parser::OPT;
-                processComparisonHelper(nextToken, "eq");
-            }
-            break;
-        case 'n':
-            if(nextToken.value == "ne") {
-                nextToken.type = Parser::OPT;
-                processComparisonHelper(nextToken, "ne");
-            }
-            break;
-        case '>':
-            nextToken.type = Parser::OPT;
-            processComparisonHelper(nextToken, "gr");
-            break;
-        case '<':
-            nextToken.type = Parser::OPT;
-            processComparisonHelper(nextToken, "ls");
-            break;
-        default:
+        const OperatorInfo& op = operatorTable[index];
+        if(op.precedence < minPrecedence || op.precedence > maxPrecedence)
             break;
-    }
-}
-
-/**
- * Comparison helper utility - processes comparison operations
- * Helper function for handling various comparison operators
- */
-void Parser::processComparisonHelper(Token nextToken, string tokenValue) {
-    consumeToken(nextToken);
-    processArithmeticExpression();
-    Token t(tokenValue, Parser::OPT);
-    constructTreeNode(t, 2);
-}
-
-/**
- * Arithmetic expression parser - handles addition and subtraction
- * Processes arithmetic expressions with + and - operators
- */
-void Parser::processArithmeticExpression() {
-    switch(nextToken.value[0]) {
-        case '-':
-            {
-                Token negToken("-", OPT);
-                consumeToken(negToken);
-                processArithmeticTerm();
-                Token nodeToken("neg", "neg");
-                constructTreeNode(nodeToken, 1);
-            }
-            break;
-        case '+':
+        
+        consumeToken(nextToken);
+        switch(op.shape) {
+            case LEFT_ASSOCIATIVE:
+                maxPrecedence = min(maxPrecedence, processOperatorExpression(op.precedence + 1));
+                constructTreeNode(operatorTokenIds[index], 2);
+                break;
+            case RIGHT_ASSOCIATIVE:
+                maxPrecedence = min(maxPrecedence, processOperatorExpression(op.precedence));
+                constructTreeNode(operatorTokenIds[index], 2);
+                break;
+            case NON_ASSOCIATIVE:
+                processOperatorExpression(op.precedence + 1);
+                constructTreeNode(operatorTokenIds[index], 2);
+                maxPrecedence = op.precedence - 1;
+                break;
+            case CONDITIONAL:
             {
-                Token posToken("+", OPT);
-                consumeToken(posToken);
-                processArithmeticTerm();
+                processOperatorExpression(op.precedence);
+                Token elseToken("|", OPT);
+                consumeToken(elseToken);
+                processOperatorExpression(op.precedence);
+                constructTreeNode(conditionalTokenId, 3);
+                maxPrecedence = op.precedence - 1;
+                break;
             }
-            break;
-        default:
-            processArithmeticTerm();
-            break;
-    }
-    
-    while(nextToken.value == "+" || nextToken.value == "-") {
-        Token temp = nextToken;
-        consumeToken(nextToken);
-        processArithmeticTerm();
-        constructTreeNode(temp, 2);
+            case AT_APPLICATION:
+                if(nextToken.type != ID)
+                    throwSyntaxError("an identifier after '@'");
+                consumeToken(nextToken);
+                processRationalExpression();
+                constructTreeNode(operatorTokenIds[index], 3);
+                break;
+        }
     }
+    return maxPrecedence;
 }
 
 /**
- * Arithmetic term parser - handles multiplication and division
- * Processes arithmetic terms with * and / operators
+ * Prefix expression parser - handles not and unary +/- where the grammar allows them
+ * not applies to a comparison, unary minus to a multiplicative term; anything
+ * else starts a function application. Returns the precedence limit its
+ * operand leaves, as processOperatorExpression does
  */
-void Parser::processArithmeticTerm() {
-    processArithmeticFactor();
-    while(nextToken.value == "*" || nextToken.value == "/") {
-        Token temp = nextToken;
+int Parser::processPrefixExpression(int minPrecedence) {
+    int maxPrecedence = HIGHEST_PRECEDENCE;
+    if(nextToken.value == "not" && minPrecedence <= NOT_PRECEDENCE) {
         consumeToken(nextToken);
-        processArithmeticFactor();
-        constructTreeNode(temp, 2);
-    }
-}
-
-/**
- * Arithmetic factor parser - handles exponentiation
- * Processes arithmetic factors with ** operator
- */
-void Parser::processArithmeticFactor() {
-    processArithmeticPrimary();
-    while(nextToken.value == "**") {
-        Token temp = nextToken;
+        maxPrecedence = processOperatorExpression(NOT_PRECEDENCE + 1);
+        constructTreeNode(notTokenId, 1);
+    } else if(nextToken.value == "-" && minPrecedence <= ADDITIVE_PRECEDENCE) {
         consumeToken(nextToken);
-        processArithmeticFactor();
-        constructTreeNode(temp, 2);
-    }
-}
-
-/**
- * Arithmetic primary parser - handles @ operator
- * Processes arithmetic primaries with @ operator
- */
-void Parser::processArithmeticPrimary() {
-    processRationalExpression();
-    while(nextToken.value == "@") {
-        Token temp = nextToken;
-        consumeToken(nextToken);
-        if(nextToken.type != ID)
-            throw "Expected Identifier found in processArithmeticPrimary()";
+        maxPrecedence = processOperatorExpression(ADDITIVE_PRECEDENCE + 1);
+        constructTreeNode(negTokenId, 1);
+    } else if(nextToken.value == "+" && minPrecedence <= ADDITIVE_PRECEDENCE) {
         consumeToken(nextToken);
+        maxPrecedence = processOperatorExpression(ADDITIVE_PRECEDENCE + 1);
+    } else {
         processRationalExpression();
-        constructTreeNode(temp, 3);
     }
+    return maxPrecedence;
 }
 
 /**
@@ -384,15 +334,22 @@ void Parser::processArithmeticPrimary() {
  */
 void Parser::processRationalExpression() {
     processRationalNode();
-    while(nextToken.type == ID || nextToken.type == STR || nextToken.type == INT ||
-          nextToken.value == "true" || nextToken.value == "false" || nextToken.value == "nil" ||
-          nextToken.value == "(" || nextToken.value == "dummy") {
+    while(startsRationalNode()) {
         processRationalNode();
-        Token nodeToken("gamma", "gamma");
-        constructTreeNode(nodeToken, 2);
+        constructTreeNode(gammaTokenId, 2);
     }
 }
 
+/**
+ * Rational node lookahead - true when the next token can start an operand
+ */
+bool Parser::startsRationalNode() {
+    if(nextToken.type == ID || nextToken.type == STR || nextToken.type == INT)
+        return true;
+    const string& value = nextToken.value;
+    return value == "true" || value == "false" || value == "nil" || value == "(" || value == "dummy";
+}
+
 /**
  * Rational node parser - handles basic expressions and literals
  * Processes identifiers, strings, integers, booleans, nil, dummy, and parenthesized expressions
@@ -400,39 +357,19 @@ void Parser::processRationalExpression() {
 void Parser::processRationalNode() {
     if(nextToken.type == ID || nextToken.type == STR || nextToken.type == INT) {
         consumeToken(nextToken);
+        return;
+    }
+    
+    const string& value = nextToken.value;
+    if(value == "true" || value == "false" || value == "nil" || value == "dummy") {
+        processRationalHelper(nextToken, value);
+    } else if(value == "(") {
+        consumeToken(nextToken);
+        processMainExpression();
+        Token t(")", ")");
+        consumeToken(t);
     } else {
-        switch(nextToken.value[0]) {
-            case 't':
-                if(nextToken.value == "true") {
-                    processRationalHelper(nextToken, "true");
-                }
-                break;
-            case 'f':
-                if(nextToken.value == "false") {
-                    processRationalHelper(nextToken, "false");
-                }
-                break;
-            case 'n':
-                if(nextToken.value == "nil") {
-                    processRationalHelper(nextToken, "nil");
-                }
-                break;
-            case 'd':
-                if(nextToken.value == "dummy") {
-                    processRationalHelper(nextToken, "dummy");
-                }
-                break;
-            case '(':
-            {
-                consumeToken(nextToken);
-                processMainExpression();
-                Token t(")", ")");
-                consumeToken(t);
-                break;
-            }
-            default:
-                break;
-        }
+        throwSyntaxError("an operand");
     }
 }
 
@@ -440,12 +377,20 @@ void Parser::processRationalNode() {
  * Rational helper utility - processes literal values
  * Helper function for handling boolean, nil, and dummy literals
  */
-void Parser::processRationalHelper(Token t, string value) {
-    consumeToken(t);
+void Parser::processRationalHelper(const Token& t, const string& value) {
     Token nodeToken(value, value);
+    consumeToken(t);
     constructTreeNode(nodeToken, 0);
 }
 
+/**
+ * Error reporting utility - aborts the parse with a descriptive message
+ */
+void Parser::throwSyntaxError(const string& expected) {
+    string found = nextToken.value.empty() ? "end of input" : "'" + nextToken.value + "'";
+    throw runtime_error("syntax error: expected " + expected + " but found " + found);
+}
+
 /**
  * Declaration parser - handles within declarations
  * Processes declarations with optional within clauses
@@ -565,45 +510,6 @@ void Parser::processVariableList() {
     }
 }
 
-/**
- * Tree visualization utility - prints the AST structure
- * Prints the constructed AST in a formatted manner
- */
-void Parser::printTree() {
-    TreeNode* t = stk.top();
-    stk.pop();
-    stk.push(t);
-    traversePreOrder(t, std::string(""));
-}
-
-/**
- * Tree traversal utility - performs pre-order traversal
- * Traverses the AST in pre-order for printing
- */
-void Parser::traversePreOrder(TreeNode* t, std::string dots) {
-    displayFormattedToken(t->value, dots);
-    string dots1 = "." + dots;
-    if(t->left != NULL)
-        traversePreOrder(t->left, dots1);
-    if(t->right != NULL)
-        traversePreOrder(t->right, dots);
-}
-
-/**
- * Token formatting utility - formats tokens for display
- * Formats different token types for tree visualization
- */
-void Parser::displayFormattedToken(Token t, std::string dots) {
-    switch(t.type[0]) {
-        case 'I':
-            break;
-        case 'S':
-            break;
-        default:
-            break;
-    }
-}
-
 /**
  * Tree accessor utility - returns the constructed AST
  * Returns the root of the constructed Abstract Syntax Tree
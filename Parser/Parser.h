@@ -3,7 +3,8 @@
  * This header defines the interface for a recursive descent parser that constructs
  * Abstract Syntax Trees (AST) for a functional programming language. The parser
  * processes tokens from a lexical analyzer and builds tree structures using
- * stack-based operations following defined grammar rules.
+ * stack-based operations following defined grammar rules. Operator expressions
+ * are parsed by precedence climbing over a compile-time operator table.
  */
 
 #include <string>
@@ -12,6 +13,7 @@
 #include <cstdlib>
 #include "Token.h"
 #include "TreeNode.h"
+#include "TreeArena.h"
 #include "Lexer.h"
 
 #ifndef PARSER_H_
@@ -22,37 +24,34 @@ using namespace std;
 class Parser {
 private:
     Lexer* lexer;
+    TreeArena* arena;
     stack<TreeNode*> stk;
     Token nextToken;
     bool tokensLeft;
     
     /**
-     * Utility functions for tree construction and display
+     * Utility functions for tree construction
      */
-    void displayFormattedToken(Token t, string dots);
-    void traversePreOrder(TreeNode* t, string dots);
-    void consumeToken(Token token);
-    void constructTreeNode(Token token, int numOfNodes);
+    void consumeToken(const Token& token);
+    void constructTreeNode(const Token& token, int numOfNodes);
+    void constructTreeNode(unsigned int tokenId, int numOfNodes);
     void attachRightChild(TreeNode* t);
     
     /**
-     * Expression parsing functions - ordered by precedence
+     * Expression parsing functions - let, fn, where and tuples
      */
     void processMainExpression();
     void processWhereExpression();
     void processTupleExpression();
-    void processAugmentExpression();
-    void processConditionalExpression();
-    void processBooleanExpression();
-    void processBooleanTerm();
-    void processBooleanStatement();
-    void processBooleanPrimary();
-    void processArithmeticExpression();
-    void processArithmeticTerm();
-    void processArithmeticFactor();
-    void processArithmeticPrimary();
+    
+    /**
+     * Operator expression parsing - precedence climbing from aug down to application
+     */
+    int processOperatorExpression(int minPrecedence);
+    int processPrefixExpression(int minPrecedence);
     void processRationalExpression();
     void processRationalNode();
+    bool startsRationalNode();
     
     /**
      * Declaration parsing functions
@@ -67,11 +66,20 @@ private:
     /**
      * Helper functions for specific parsing tasks
      */
-    void processComparisonHelper(Token nextToken, string tokenValue);
-    void processRationalHelper(Token t, string value);
+    void processRationalHelper(const Token& t, const string& value);
+    void throwSyntaxError(const string& expected);
+    
+    /**
+     * Interned ids of the tokens the parser builds most often
+     */
+    unsigned int gammaTokenId;
+    unsigned int negTokenId;
+    unsigned int notTokenId;
+    unsigned int conditionalTokenId;
+    vector<unsigned int> operatorTokenIds;
 
 public:
-    Parser(Lexer* analyzer);
+    Parser(Lexer* analyzer, TreeArena* arena);
     virtual ~Parser();
     
     /**
@@ -79,7 +87,6 @@ public:
      */
     void parse();
     TreeNode* getTree();
-    void printTree();
     
     /**
      * Static token type constants
@@ -12,45 +12,65 @@
 #include <iostream>
 #include <queue>
 #include <stack>
+#include <vector>
 
 using namespace std;
 
-void displayTreeNodes(TreeNode* node);
+void displayTreeNodes(TreeNode* node, const TreeArena& arena);
 
-TreeStandardizer::TreeStandardizer() {
-    this->gammaToken = Token("gamma", "gamma");
-    this->lambdaToken = Token("lambda", "lambda");
+TreeStandardizer::TreeStandardizer(TreeArena* arena) {
+    this->arena = arena;
+    this->gammaTokenId = arena->internToken(Token("gamma", "gamma"));
+    this->lambdaTokenId = arena->internToken(Token("lambda", "lambda"));
+    this->equalTokenId = arena->internToken(Token("=", "="));
 }
 
 TreeStandardizer::~TreeStandardizer() {
 }
 
 /**
- * Main tree standardization method - processes entire tree recursively
- * Traverses the tree and applies appropriate transformation rules
- * based on the node type encountered
+ * Main tree standardization method - processes entire tree bottom-up
+ * Children are standardized before their parent, using an explicit stack of
+ * frames instead of recursion so nesting depth is limited only by the heap
  */
 TreeNode* TreeStandardizer::standardizeTree(TreeNode* rootNode) {
-    TreeNode* currentRoot = rootNode;
-    TreeNode* nextChild = currentRoot->left;
-    bool isFirstChild = true;
+    vector<StandardizeFrame> frames;
+    frames.push_back(StandardizeFrame(rootNode));
+    TreeNode* transformedChild = NULL;
     
-    while(nextChild != NULL) {
-        TreeNode* transformedChild = standardizeTree(nextChild);
+    while(!frames.empty()) {
+        StandardizeFrame& frame = frames.back();
         
-        if(isFirstChild == true) {
-            currentRoot->left = transformedChild;
-            currentRoot = currentRoot->left;
-            isFirstChild = false;
-        } else {
-            currentRoot->right = transformedChild;
-            currentRoot = currentRoot->right;
+        if(transformedChild != NULL) {
+            if(frame.isFirstChild == true) {
+                frame.currentRoot->left = transformedChild;
+                frame.isFirstChild = false;
+            } else {
+                frame.currentRoot->right = transformedChild;
+            }
+            frame.currentRoot = transformedChild;
+            frame.nextChild = frame.nextChild->right;
+            transformedChild = NULL;
+        }
+        
+        if(frame.nextChild != NULL) {
+            frames.push_back(StandardizeFrame(frame.nextChild));
+            continue;
         }
-        nextChild = nextChild->right;
+        
+        transformedChild = transformNode(frame.rootNode);
+        frames.pop_back();
     }
     
-    Token nodeToken = rootNode->value;
-    string tokenValue = nodeToken.value;
+    return transformedChild;
+}
+
+/**
+ * Node transformation dispatcher - applies the rule matching the node type
+ * Called once all children of the node have been standardized
+ */
+TreeNode* TreeStandardizer::transformNode(TreeNode* rootNode) {
+    const string& tokenValue = arena->token(rootNode).value;
     
     switch(tokenValue[0]) {
         case 'l':
@@ -94,8 +114,8 @@ TreeNode* TreeStandardizer::standardizeTree(TreeNode* rootNode) {
  * let X = E1 in E2 becomes gamma(lambda X.E2)(E1)
  */
 TreeNode* TreeStandardizer::processLetExpression(TreeNode* letNode) {
-    TreeNode* lambdaNode = new TreeNode(this->lambdaToken);
-    TreeNode* gammaNode = new TreeNode(this->gammaToken);
+    TreeNode* lambdaNode = arena->createNode(lambdaTokenId);
+    TreeNode* gammaNode = arena->createNode(gammaTokenId);
     
     gammaNode->left = lambdaNode;
     lambdaNode->right = letNode->left->left->right;
@@ -110,8 +130,8 @@ TreeNode* TreeStandardizer::processLetExpression(TreeNode* letNode) {
  * E1 where X = E2 becomes gamma(lambda X.E1)(E2)
  */
 TreeNode* TreeStandardizer::processWhereExpression(TreeNode* whereNode) {
-    TreeNode* lambdaNode = new TreeNode(this->lambdaToken);
-    TreeNode* gammaNode = new TreeNode(this->gammaToken);
+    TreeNode* lambdaNode = arena->createNode(lambdaTokenId);
+    TreeNode* gammaNode = arena->createNode(gammaTokenId);
     
     gammaNode->left = lambdaNode;
     gammaNode->left->right = whereNode->left->right->left->right;
@@ -145,7 +165,7 @@ TreeNode* TreeStandardizer::processLambdaExpression(TreeNode* lambdaNode) {
         nodeStack.pop();
         TreeNode* leftChild = nodeStack.top();
         nodeStack.pop();
-        TreeNode* newLambdaNode = new TreeNode(this->lambdaToken);
+        TreeNode* newLambdaNode = arena->createNode(lambdaTokenId);
         newLambdaNode->left = leftChild;
         leftChild->right = rightChild;
         nodeStack.push(newLambdaNode);
@@ -161,8 +181,7 @@ TreeNode* TreeStandardizer::processLambdaExpression(TreeNode* lambdaNode) {
  * f X1 X2 ... Xn = E becomes f = lambda X1.(lambda X2.(...(lambda Xn.E)...))
  */
 TreeNode* TreeStandardizer::processFunctionForm(TreeNode* functionNode) {
-    Token equalToken("=", "=");
-    TreeNode* equalNode = new TreeNode(equalToken);
+    TreeNode* equalNode = arena->createNode(equalTokenId);
     int parameterCount = 0;
     stack<TreeNode*> nodeStack;
     
@@ -184,7 +203,7 @@ TreeNode* TreeStandardizer::processFunctionForm(TreeNode* functionNode) {
         nodeStack.pop();
         
         secondNode->right = firstNode;
-        TreeNode* lambdaNode = new TreeNode(this->lambdaToken);
+        TreeNode* lambdaNode = arena->createNode(lambdaTokenId);
         lambdaNode->left = secondNode;
         nodeStack.push(lambdaNode);
         parameterCount--;
@@ -206,10 +225,9 @@ TreeNode* TreeStandardizer::processFunctionForm(TreeNode* functionNode) {
  * E1 within X2 = E2 becomes X2 = gamma(lambda X1.E2)(E1)
  */
 TreeNode* TreeStandardizer::processWithinExpression(TreeNode* withinNode) {
-    Token equalToken("=", "=");
-    TreeNode* equalNode = new TreeNode(equalToken);
-    TreeNode* gammaNode = new TreeNode(this->gammaToken);
-    TreeNode* lambdaNode = new TreeNode(this->lambdaToken);
+    TreeNode* equalNode = arena->createNode(equalTokenId);
+    TreeNode* gammaNode = arena->createNode(gammaTokenId);
+    TreeNode* lambdaNode = arena->createNode(lambdaTokenId);
     
     gammaNode->left = lambdaNode;
     lambdaNode->right = withinNode->left->left->right;
@@ -226,8 +244,8 @@ TreeNode* TreeStandardizer::processWithinExpression(TreeNode* withinNode) {
  * E1 @ E2 E3 becomes gamma(gamma E2 E1) E3
  */
 TreeNode* TreeStandardizer::processAtExpression(TreeNode* atNode) {
-    TreeNode* gammaNode1 = new TreeNode(this->gammaToken);
-    TreeNode* gammaNode2 = new TreeNode(this->gammaToken);
+    TreeNode* gammaNode1 = arena->createNode(gammaTokenId);
+    TreeNode* gammaNode2 = arena->createNode(gammaTokenId);
     
     gammaNode1->left = gammaNode2;
     TreeNode* e2 = atNode->left->right->right;
@@ -247,15 +265,11 @@ TreeNode* TreeStandardizer::processAtExpression(TreeNode* atNode) {
  * Converts multiple bindings into comma-separated tuples with tau
  */
 TreeNode* TreeStandardizer::processAndExpression(TreeNode* andNode) {
-    Token equalToken("=", "=");
-    TreeNode* equalNode = new TreeNode(equalToken);
-    Token commaToken(",", ",");
-    TreeNode* commaNode = new TreeNode(commaToken);
+    TreeNode* equalNode = arena->createNode(equalTokenId);
+    TreeNode* commaNode = arena->createNode(Token(",", ","));
     Token tauToken("tau", "tau");
-    TreeNode* tauNode = new TreeNode();
     
     equalNode->left = commaNode;
-    commaNode->right = tauNode;
     TreeNode* andChild = andNode->left;
     queue<TreeNode*> equalQueue;
     int tauCount = 0;
@@ -267,7 +281,8 @@ TreeNode* TreeStandardizer::processAndExpression(TreeNode* andNode) {
     }
     
     tauToken.tauCount = tauCount;
-    tauNode->value = tauToken;
+    TreeNode* tauNode = arena->createNode(tauToken);
+    commaNode->right = tauNode;
     TreeNode* currentParam = NULL;
     TreeNode* currentValue = NULL;
     
@@ -299,17 +314,15 @@ TreeNode* TreeStandardizer::processAndExpression(TreeNode* andNode) {
  * rec X = E becomes X = YSTAR(lambda X.E)
  */
 TreeNode* TreeStandardizer::processRecExpression(TreeNode* recNode) {
-    Token equalToken("=", "=");
-    TreeNode* equalNode = new TreeNode(equalToken);
-    TreeNode* gammaNode = new TreeNode(this->gammaToken);
-    TreeNode* lambdaNode = new TreeNode(this->lambdaToken);
-    Token ystarToken("YSTAR", "YSTAR");
-    TreeNode* ystarNode = new TreeNode(ystarToken);
+    TreeNode* equalNode = arena->createNode(equalTokenId);
+    TreeNode* gammaNode = arena->createNode(gammaTokenId);
+    TreeNode* lambdaNode = arena->createNode(lambdaTokenId);
+    TreeNode* ystarNode = arena->createNode(Token("YSTAR", "YSTAR"));
     
     TreeNode* expression = recNode->left->left->right;
     TreeNode* variable1 = recNode->left->left;
     variable1->right = NULL;
-    TreeNode* variable2 = new TreeNode(variable1->value);
+    TreeNode* variable2 = arena->createNode(variable1->tokenId);
     
     equalNode->left = variable1;
     variable1->right = gammaNode;
@@ -322,20 +335,20 @@ TreeNode* TreeStandardizer::processRecExpression(TreeNode* recNode) {
 }
 
 /**
- * Creates a copy of a tree node with the same value
+ * Creates a copy of a tree node sharing the same interned token
  */
 TreeNode* TreeStandardizer::createNodeCopy(TreeNode* sourceNode) {
-    return new TreeNode(sourceNode->value);
+    return arena->createNode(sourceNode->tokenId);
 }
 
 /**
  * Utility function to display tree nodes recursively
  * Used for debugging and visualization purposes
  */
-void displayTreeNodes(TreeNode* node) {
-    cout << node->value.value << endl;
+void displayTreeNodes(TreeNode* node, const TreeArena& arena) {
+    cout << arena.token(node).value << endl;
     if(node->left != NULL)
-        displayTreeNodes(node->left);
+        displayTreeNodes(node->left, arena);
     if(node->right != NULL)
-        displayTreeNodes(node->right);
+        displayTreeNodes(node->right, arena);
 }
\ No newline at end of file
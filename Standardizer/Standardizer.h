@@ -13,19 +13,38 @@
 #define TREESTANDARDIZER_H_
 
 #include "TreeNode.h"
+#include "TreeArena.h"
+#include <vector>
 
-void displayTreeNodes(TreeNode* node);
+void displayTreeNodes(TreeNode* node, const TreeArena& arena);
+
+/**
+ * Pending work for one node during the iterative bottom-up walk:
+ * the node itself, the last standardized child it links to, and the
+ * next original child still to be standardized
+ */
+struct StandardizeFrame {
+    StandardizeFrame(TreeNode* node)
+        : rootNode(node), currentRoot(node), nextChild(node->left), isFirstChild(true) {}
+    
+    TreeNode* rootNode;
+    TreeNode* currentRoot;
+    TreeNode* nextChild;
+    bool isFirstChild;
+};
 
 class TreeStandardizer {
 private:
+    TreeArena* arena;
     TreeNode* createNodeCopy(TreeNode* sourceNode);
+    TreeNode* transformNode(TreeNode* rootNode);
     
 public:
-    TreeStandardizer();
+    TreeStandardizer(TreeArena* arena);
     virtual ~TreeStandardizer();
     
     /**
-     * Main transformation entry point - processes entire tree recursively
+     * Main transformation entry point - processes entire tree bottom-up
      * Applies appropriate standardization rules based on node type
      */
     TreeNode* standardizeTree(TreeNode* rootNode);
@@ -43,8 +62,9 @@ public:
     TreeNode* processAndExpression(TreeNode* andNode);
     TreeNode* processRecExpression(TreeNode* recNode);
     
-    Token lambdaToken;
-    Token gammaToken;
+    unsigned int lambdaTokenId;
+    unsigned int gammaTokenId;
+    unsigned int equalTokenId;
 };
 
 #endif /* TREESTANDARDIZER_H_ */
\ No newline at end of file
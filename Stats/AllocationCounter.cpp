@@ -0,0 +1,52 @@
+/**
+ * Allocation Counter Implementation
+ *
+ * Counting replacements for the global allocation functions, compiled only
+ * into diagnostic builds. Array and nothrow forms are routed through the
+ * counted operator new so every allocation is seen exactly once.
+ */
+
+#include "AllocationCounter.h"
+
+#ifdef RPAL_COUNT_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+unsigned long long allocationCount = 0;
+unsigned long long allocatedBytes = 0;
+
+void* operator new(std::size_t size) {
+	allocationCount++;
+	allocatedBytes += size;
+	void* memory = std::malloc(size == 0 ? 1 : size);
+	if(memory == NULL)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return operator new(size);
+	} catch(...) {
+		return NULL;
+	}
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	std::free(memory);
+}
+
+#endif
@@ -0,0 +1,24 @@
+/**
+ * Allocation Counter Header
+ *
+ * Diagnostic builds (-DRPAL_COUNT_ALLOCATIONS, "make alloc-diag") replace the
+ * global operator new and delete with versions that count every heap
+ * allocation. ALLOCATION_COUNT() reads the running total; run statistics
+ * take differences of it per phase and per machine step. In normal builds
+ * the hooks are not compiled and ALLOCATION_COUNT() is the constant 0.
+ */
+
+#ifndef ALLOCATIONCOUNTER_H_
+#define ALLOCATIONCOUNTER_H_
+
+#ifdef RPAL_COUNT_ALLOCATIONS
+extern unsigned long long allocationCount;     // Calls to operator new since start-up
+extern unsigned long long allocatedBytes;      // Bytes requested by those calls
+#define ALLOCATION_COUNT() (allocationCount)
+#define ALLOCATION_COUNTING_ENABLED true
+#else
+#define ALLOCATION_COUNT() (0ULL)
+#define ALLOCATION_COUNTING_ENABLED false
+#endif
+
+#endif /* ALLOCATIONCOUNTER_H_ */
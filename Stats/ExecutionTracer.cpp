@@ -0,0 +1,190 @@
+/**
+ * Execution Tracer Implementation
+ *
+ * Ring buffer of complete and instant events, written as Chrome trace-event
+ * JSON: phases on one track, closure applications and builtins on another.
+ */
+
+#include "ExecutionTracer.h"
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+// Track (tid) of each event kind in the trace
+static const int PIPELINE_TRACK = 1;
+static const int MACHINE_TRACK = 2;
+
+ExecutionTracer::ExecutionTracer(unsigned int capacity, unsigned int sampleInterval) {
+	this->events.resize(capacity == 0 ? 1 : capacity);
+	this->origin = Clock::now();
+	this->next = 0;
+	this->recordedCount = 0;
+	this->sampleInterval = sampleInterval == 0 ? 1 : sampleInterval;
+	this->applications = 0;
+	this->builtinCalls = 0;
+}
+
+unsigned long long ExecutionTracer::sinceOrigin(Clock::time_point time) const {
+	return chrono::duration_cast<chrono::nanoseconds>(time - origin).count();
+}
+
+unsigned long long ExecutionTracer::now() const {
+	return sinceOrigin(Clock::now());
+}
+
+// Overwrites the oldest event once the buffer is full
+void ExecutionTracer::record(const Event& event) {
+	events[next] = event;
+	next = next + 1 == events.size() ? 0 : next + 1;
+	recordedCount++;
+}
+
+int ExecutionTracer::nameIndex(const string& name) {
+	for(unsigned int i = 0; i < names.size(); i++) {
+		if(names[i] == name)
+			return i;
+	}
+	names.push_back(name);
+	return names.size() - 1;
+}
+
+/**
+ * Closure application - opens a span; only every sampleInterval-th one is
+ * recorded, but every one is pushed so that env pops stay matched
+ */
+void ExecutionTracer::enter(int deltaNum, const string& param, int line) {
+	if(deltaNum >= (int)labels.size())
+		labels.resize(deltaNum + 1);
+	DeltaLabel& delta = labels[deltaNum];
+	if(!delta.seen) {
+		delta.seen = true;
+		delta.param = param;
+		delta.line = line;
+	}
+
+	Frame frame;
+	frame.deltaNum = deltaNum;
+	frame.recorded = applications++ % sampleInterval == 0;
+	frame.startNs = frame.recorded ? now() : 0;
+	frames.push_back(frame);
+}
+
+/**
+ * Environment pop - closes the innermost span as one complete event
+ */
+void ExecutionTracer::exit() {
+	if(frames.empty())
+		return;
+	const Frame& frame = frames.back();
+	if(frame.recorded) {
+		Event event = { frame.startNs, now() - frame.startNs, LAMBDA, frame.deltaNum };
+		record(event);
+	}
+	frames.pop_back();
+}
+
+/**
+ * End of evaluation - closes any spans left open, innermost first
+ */
+void ExecutionTracer::finish() {
+	while(!frames.empty())
+		exit();
+}
+
+void ExecutionTracer::builtin(const string& name) {
+	if(builtinCalls++ % sampleInterval != 0)
+		return;
+	Event event = { now(), 0, BUILTIN, nameIndex(name) };
+	record(event);
+}
+
+void ExecutionTracer::phase(const char* name, Clock::time_point start, Clock::time_point end) {
+	Event event = { sinceOrigin(start), sinceOrigin(end) - sinceOrigin(start), PHASE, nameIndex(name) };
+	phases.push_back(event);
+}
+
+void ExecutionTracer::nameDelta(int deltaNum, const string& name) {
+	if(deltaNum >= (int)labels.size())
+		labels.resize(deltaNum + 1);
+	if(labels[deltaNum].name.empty())
+		labels[deltaNum].name = name;
+}
+
+/**
+ * Display name - same scheme as the lambda profiler: bound identifier or
+ * bound variable, then the source line
+ */
+string ExecutionTracer::label(int deltaNum) const {
+	ostringstream oss;
+	if(deltaNum >= (int)labels.size()) {
+		oss << "lambda#" << deltaNum;
+		return oss.str();
+	}
+	const DeltaLabel& delta = labels[deltaNum];
+	if(!delta.name.empty())
+		oss << delta.name;
+	else
+		oss << "lambda(" << delta.param << ")";
+	if(delta.line > 0)
+		oss << ':' << delta.line;
+	return oss.str();
+}
+
+// JSON string literal; labels are identifiers, but parameter lists and
+// builtin names go through here too
+static void writeJsonString(ostream& out, const string& value) {
+	out << '"';
+	for(unsigned int i = 0; i < value.size(); i++) {
+		char c = value[i];
+		if(c == '"' || c == '\\')
+			out << '\\' << c;
+		else if((unsigned char)c < 0x20)
+			out << "\\u" << hex << setw(4) << setfill('0') << (int)c << dec << setfill(' ');
+		else
+			out << c;
+	}
+	out << '"';
+}
+
+/**
+ * Trace-event JSON - track names, then the buffered events oldest first.
+ * Timestamps are microseconds since the tracer was created
+ */
+void ExecutionTracer::writeJson(ostream& out) const {
+	unsigned long long dropped = recordedCount > events.size() ? recordedCount - events.size() : 0;
+	unsigned int count = recordedCount < events.size() ? (unsigned int)recordedCount : events.size();
+	unsigned int first = recordedCount < events.size() ? 0 : next;
+
+	out << fixed << setprecision(3);
+	out << "{\"traceEvents\": [" << endl;
+	out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << PIPELINE_TRACK
+		<< ", \"args\": {\"name\": \"pipeline\"}}," << endl;
+	out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << MACHINE_TRACK
+		<< ", \"args\": {\"name\": \"cse machine\"}}";
+	for(unsigned int i = 0; i < phases.size() + count; i++) {
+		const Event& event = i < phases.size() ? phases[i] : events[(first + i - phases.size()) % events.size()];
+		out << "," << endl << "{\"name\": ";
+		if(event.kind == LAMBDA)
+			writeJsonString(out, label(event.id));
+		else
+			writeJsonString(out, names[event.id]);
+		switch(event.kind) {
+		case LAMBDA:
+			out << ", \"cat\": \"lambda\", \"ph\": \"X\", \"tid\": " << MACHINE_TRACK;
+			break;
+		case BUILTIN:
+			out << ", \"cat\": \"builtin\", \"ph\": \"i\", \"s\": \"t\", \"tid\": " << MACHINE_TRACK;
+			break;
+		default:
+			out << ", \"cat\": \"phase\", \"ph\": \"X\", \"tid\": " << PIPELINE_TRACK;
+			break;
+		}
+		out << ", \"pid\": 1, \"ts\": " << event.startNs / 1e3;
+		if(event.kind != BUILTIN)
+			out << ", \"dur\": " << event.durationNs / 1e3;
+		out << "}";
+	}
+	out << endl << "], \"displayTimeUnit\": \"ms\", \"otherData\": {\"sample_interval\": " << sampleInterval
+		<< ", \"buffer_events\": " << events.size() << ", \"dropped_events\": " << dropped << "}}" << endl;
+}
@@ -0,0 +1,82 @@
+/**
+ * Execution Tracer Header
+ *
+ * Records a timeline of one run for --trace: a span per closure application
+ * (from the gamma that enters it to the env pop that leaves it), an instant
+ * per builtin call and a span per pipeline phase. Spans are stored as
+ * complete events when they close, in a fixed-size ring buffer, so a long
+ * run keeps its most recent events and a dropped event never leaves an
+ * unmatched begin or end behind; the few phase spans are kept aside so they
+ * always survive. With a sampling interval of n only every nth application
+ * and builtin call is recorded. The buffer is written as a Chrome
+ * trace-event JSON file, which chrome://tracing and Perfetto open.
+ */
+
+#ifndef EXECUTIONTRACER_H_
+#define EXECUTIONTRACER_H_
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class ExecutionTracer {
+public:
+	ExecutionTracer(unsigned int capacity = 1 << 18, unsigned int sampleInterval = 1);
+
+	void enter(int deltaNum, const std::string& param, int line);  // A closure of deltaNum was applied
+	void exit();                                                   // Its environment was popped
+	void finish();                                                 // Closes every open span
+	void builtin(const std::string& name);                         // A builtin function was applied
+	void phase(const char* name, std::chrono::steady_clock::time_point start,
+			std::chrono::steady_clock::time_point end);
+	void nameDelta(int deltaNum, const std::string& name);         // First identifier a closure was bound to
+
+	void writeJson(std::ostream& out) const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	enum Kind { LAMBDA, BUILTIN, PHASE };
+
+	struct Event {
+		unsigned long long startNs;
+		unsigned long long durationNs;
+		int kind;
+		int id;                         // Delta number, or index into names
+	};
+
+	struct DeltaLabel {
+		DeltaLabel() : line(0), seen(false) {}
+		std::string name;
+		std::string param;
+		int line;
+		bool seen;
+	};
+
+	struct Frame {
+		int deltaNum;
+		unsigned long long startNs;
+		bool recorded;                  // False for applications skipped by sampling
+	};
+
+	Clock::time_point origin;
+	std::vector<Event> events;          // Ring buffer; next is the slot written next
+	unsigned int next;
+	unsigned long long recordedCount;
+	unsigned int sampleInterval;
+	unsigned long long applications;
+	unsigned long long builtinCalls;
+	std::vector<Event> phases;
+	std::vector<Frame> frames;
+	std::vector<DeltaLabel> labels;     // Indexed by delta number
+	std::vector<std::string> names;     // Builtin and phase names
+
+	unsigned long long now() const;
+	unsigned long long sinceOrigin(Clock::time_point time) const;
+	void record(const Event& event);
+	int nameIndex(const std::string& name);
+	std::string label(int deltaNum) const;
+};
+
+#endif /* EXECUTIONTRACER_H_ */
@@ -0,0 +1,122 @@
+/**
+ * Hardware Counters Implementation
+ *
+ * Opens one perf event per counter and reads it with the enabled and running
+ * times, so counts stay comparable when the kernel multiplexes more events
+ * than the PMU has registers. Builds on other systems compile to a stub that
+ * reports every event unavailable.
+ */
+
+#include "HardwareCounters.h"
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+HardwareCounters::Snapshot::Snapshot() {
+	for(int i = 0; i < EVENT_COUNT; i++)
+		values[i] = 0;
+}
+
+HardwareCounters::HardwareCounters() {
+	for(int i = 0; i < EVENT_COUNT; i++)
+		descriptors[i] = -1;
+}
+
+HardwareCounters::~HardwareCounters() {
+#ifdef __linux__
+	for(int i = 0; i < EVENT_COUNT; i++)
+		if(descriptors[i] >= 0)
+			close(descriptors[i]);
+#endif
+}
+
+#ifdef __linux__
+static unsigned long long cacheReadMiss(unsigned long long cache) {
+	return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+#endif
+
+/**
+ * Opens every event that the system allows; returns true if at least one opened
+ */
+bool HardwareCounters::open() {
+#ifdef __linux__
+	struct EventConfig {
+		unsigned int type;
+		unsigned long long config;
+	};
+	const EventConfig configs[EVENT_COUNT] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+		{ PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_L1D) },
+		{ PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_LL) },
+		{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+	};
+	for(int i = 0; i < EVENT_COUNT; i++) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = configs[i].type;
+		attr.config = configs[i].config;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		descriptors[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		if(descriptors[i] < 0 && openError.empty()) {
+			openError = string(eventName((Event)i)) + ": " + strerror(errno);
+			if(errno == EACCES || errno == EPERM)
+				openError += " (see /proc/sys/kernel/perf_event_paranoid)";
+		}
+	}
+#else
+	openError = "perf events are only supported on Linux";
+#endif
+	return anyAvailable();
+}
+
+bool HardwareCounters::available(Event event) const {
+	return descriptors[event] >= 0;
+}
+
+bool HardwareCounters::anyAvailable() const {
+	for(int i = 0; i < EVENT_COUNT; i++)
+		if(descriptors[i] >= 0)
+			return true;
+	return false;
+}
+
+HardwareCounters::Snapshot HardwareCounters::read() const {
+	Snapshot snapshot;
+#ifdef __linux__
+	for(int i = 0; i < EVENT_COUNT; i++) {
+		if(descriptors[i] < 0)
+			continue;
+		unsigned long long data[3];         // value, time enabled, time running
+		if(::read(descriptors[i], data, sizeof(data)) != (ssize_t)sizeof(data))
+			continue;
+		if(data[2] != 0 && data[2] < data[1])
+			data[0] = (unsigned long long)((double)data[0] * data[1] / data[2]);
+		snapshot.values[i] = data[0];
+	}
+#endif
+	return snapshot;
+}
+
+const string& HardwareCounters::error() const {
+	return openError;
+}
+
+const char* HardwareCounters::eventName(Event event) {
+	static const char* names[EVENT_COUNT] = {
+		"cycles", "instructions", "branch-misses", "l1d-misses", "llc-misses", "page-faults"
+	};
+	return names[event];
+}
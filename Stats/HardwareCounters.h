@@ -0,0 +1,47 @@
+/**
+ * Hardware Counters Header
+ *
+ * Reads CPU performance counters through Linux perf_event_open for --hwcounters:
+ * cycles, instructions, branch misses, L1 data cache and last-level cache read
+ * misses, plus page faults as a software event. Each event is opened on its
+ * own, counting this process in user space only, so an event the CPU or the
+ * kernel does not offer - or that perf_event_paranoid forbids - is simply
+ * reported as unavailable while the others keep working. Counters run from
+ * open() on; phases are measured as differences of read() snapshots.
+ */
+
+#ifndef HARDWARECOUNTERS_H_
+#define HARDWARECOUNTERS_H_
+
+#include <string>
+
+class HardwareCounters {
+public:
+	enum Event { CYCLES, INSTRUCTIONS, BRANCH_MISSES, L1D_MISSES, LLC_MISSES, PAGE_FAULTS, EVENT_COUNT };
+
+	// One reading of every event; unavailable events read as 0
+	struct Snapshot {
+		Snapshot();
+		unsigned long long values[EVENT_COUNT];
+	};
+
+	HardwareCounters();
+	~HardwareCounters();
+
+	bool open();                            // False when no event could be opened
+	bool available(Event event) const;
+	bool anyAvailable() const;
+	Snapshot read() const;                  // Running totals, scaled for multiplexing
+	const std::string& error() const;       // Why the first unavailable event failed to open
+
+	static const char* eventName(Event event);
+
+private:
+	int descriptors[EVENT_COUNT];
+	std::string openError;
+
+	HardwareCounters(const HardwareCounters&);
+	HardwareCounters& operator=(const HardwareCounters&);
+};
+
+#endif /* HARDWARECOUNTERS_H_ */
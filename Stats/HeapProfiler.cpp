@@ -0,0 +1,169 @@
+/**
+ * Heap Profiler Implementation
+ *
+ * Charges environments, tuples and strings to the delta running when they
+ * are created, and measures live bytes per site with periodic walks of the
+ * values the machine holds.
+ */
+
+#include "HeapProfiler.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+// Steps between the first snapshots; later ones wait at least twice as many
+// steps as the previous walk visited values, so walking stays a bounded fraction
+static const unsigned long long MIN_SNAPSHOT_INTERVAL = 4096;
+
+static const char* kindNames[HeapProfiler::KIND_COUNT] = { "environment", "tuple", "string" };
+
+HeapProfiler::HeapProfiler() {
+	labels.resize(1);
+	labels[0].name = "main";
+	labels[0].seen = true;
+	frames.push_back(0);
+	nextSnapshot = MIN_SNAPSHOT_INTERVAL;
+	walked = 0;
+	liveTotal = 0;
+	peakTotal = 0;
+	peakSteps = 0;
+	snapshots = 0;
+}
+
+HeapProfiler::Site& HeapProfiler::site(int deltaNum, Kind kind) {
+	unsigned int index = deltaNum * KIND_COUNT + kind;
+	if(index >= sites.size())
+		sites.resize(index + KIND_COUNT);
+	return sites[index];
+}
+
+void HeapProfiler::enter(int deltaNum, const string& param, int line) {
+	if(deltaNum >= (int)labels.size())
+		labels.resize(deltaNum + 1);
+	DeltaLabel& delta = labels[deltaNum];
+	if(!delta.seen) {
+		delta.seen = true;
+		delta.param = param;
+		delta.line = line;
+	}
+	frames.push_back(deltaNum);
+}
+
+void HeapProfiler::exit() {
+	if(frames.size() > 1)
+		frames.pop_back();
+}
+
+void HeapProfiler::nameDelta(int deltaNum, const string& name) {
+	if(deltaNum >= (int)labels.size())
+		labels.resize(deltaNum + 1);
+	if(labels[deltaNum].name.empty())
+		labels[deltaNum].name = name;
+}
+
+int HeapProfiler::allocate(Kind kind, unsigned long long bytes) {
+	int deltaNum = frames.back();
+	Site& created = site(deltaNum, kind);
+	created.allocations++;
+	created.totalBytes += bytes;
+	return deltaNum;
+}
+
+void HeapProfiler::release(Kind kind, unsigned long long bytes) {
+	site(frames.back(), kind).releasedBytes += bytes;
+}
+
+unsigned long long HeapProfiler::valueBytes(const Token& value) {
+	if(value.isTuple)
+		return value.tuple.capacity() * sizeof(Token) + value.value.size();
+	return value.value.size() + 1;
+}
+
+void HeapProfiler::beginSnapshot() {
+	for(unsigned int i = 0; i < sites.size(); i++)
+		sites[i].liveBytes = 0;
+	walked = 0;
+}
+
+/**
+ * Charges a held value to the site that created it, then its tuple elements
+ * to theirs; copies of a value are separate allocations and count again
+ */
+void HeapProfiler::addLive(const Token& value) {
+	walked++;
+	if(value.allocDelta >= 0)
+		site(value.allocDelta, value.isTuple ? TUPLE : STRING).liveBytes += valueBytes(value);
+	for(unsigned int i = 0; i < value.tuple.size(); i++)
+		addLive(value.tuple[i]);
+}
+
+/**
+ * Completes a walk - environments are live until released - and keeps it as the peak
+ * when it holds more than any walk before it
+ */
+void HeapProfiler::endSnapshot(unsigned long long steps) {
+	liveTotal = 0;
+	for(unsigned int i = 0; i < sites.size(); i++) {
+		if(i % KIND_COUNT == ENVIRONMENT)
+			sites[i].liveBytes = sites[i].totalBytes - sites[i].releasedBytes;
+		liveTotal += sites[i].liveBytes;
+	}
+	snapshots++;
+	if(liveTotal >= peakTotal) {
+		peakTotal = liveTotal;
+		peakSteps = steps;
+		for(unsigned int i = 0; i < sites.size(); i++)
+			sites[i].peakBytes = sites[i].liveBytes;
+	}
+	nextSnapshot = steps + max(MIN_SNAPSHOT_INTERVAL, 2 * walked);
+}
+
+/**
+ * Display name - same scheme as the lambda profiler
+ */
+string HeapProfiler::label(int deltaNum) const {
+	ostringstream oss;
+	if(deltaNum >= (int)labels.size()) {
+		oss << "lambda#" << deltaNum;
+		return oss.str();
+	}
+	const DeltaLabel& delta = labels[deltaNum];
+	if(!delta.name.empty())
+		oss << delta.name;
+	else
+		oss << "lambda(" << delta.param << ")";
+	if(delta.line > 0)
+		oss << ':' << delta.line;
+	return oss.str();
+}
+
+/**
+ * Table - one row per site that allocated, largest at peak first
+ */
+void HeapProfiler::writeTable(ostream& out) const {
+	vector<unsigned int> rows;
+	for(unsigned int i = 0; i < sites.size(); i++) {
+		if(sites[i].allocations != 0)
+			rows.push_back(i);
+	}
+	sort(rows.begin(), rows.end(), [this](unsigned int a, unsigned int b) {
+		if(sites[a].peakBytes != sites[b].peakBytes)
+			return sites[a].peakBytes > sites[b].peakBytes;
+		if(sites[a].totalBytes != sites[b].totalBytes)
+			return sites[a].totalBytes > sites[b].totalBytes;
+		return a < b;
+	});
+
+	out << "Heap profile (" << snapshots << " snapshots, peak " << peakTotal << " live bytes at step "
+		<< peakSteps << ", " << liveTotal << " at exit)" << endl;
+	out << right << setw(12) << "kind" << setw(12) << "allocs" << setw(16) << "total bytes"
+		<< setw(14) << "peak live" << setw(14) << "exit live" << "  site" << endl;
+	for(unsigned int i = 0; i < rows.size(); i++) {
+		const Site& row = sites[rows[i]];
+		out << setw(12) << kindNames[rows[i] % KIND_COUNT] << setw(12) << row.allocations
+			<< setw(16) << row.totalBytes << setw(14) << row.peakBytes << setw(14) << row.liveBytes
+			<< "  " << label(rows[i] / KIND_COUNT) << endl;
+	}
+}
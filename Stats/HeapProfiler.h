@@ -0,0 +1,78 @@
+/**
+ * Heap Profiler Header
+ *
+ * Attributes the memory the CSE machine builds at run time to the delta
+ * (lambda body) whose code created it: environments, tuples (tau and aug)
+ * and strings (Conc, ItoS and string literals). Every creation is charged to
+ * its site - delta and kind - as it happens, and the created token carries
+ * its delta so it can be found again. Live bytes are measured by walking
+ * the values the machine still holds, on a step interval that grows with the
+ * size of the walk; the walk with the largest total is kept as the peak.
+ * Environments are live from their creation until the machine releases
+ * their frame, so they are counted as they go rather than walked.
+ * Sizes are payload estimates: the tuple slots and text of a tuple, the
+ * characters of a string, and the record and bindings of an environment.
+ */
+
+#ifndef HEAPPROFILER_H_
+#define HEAPPROFILER_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Token.h"
+
+class HeapProfiler {
+public:
+	enum Kind { ENVIRONMENT, TUPLE, STRING, KIND_COUNT };
+
+	HeapProfiler();
+
+	void enter(int deltaNum, const std::string& param, int line);  // A closure of deltaNum was applied
+	void exit();                                                   // Its environment was popped
+	void nameDelta(int deltaNum, const std::string& name);         // First identifier a closure was bound to
+
+	int allocate(Kind kind, unsigned long long bytes);             // Charges the running delta, returns it
+	void release(Kind kind, unsigned long long bytes);             // Credits the running delta
+	static unsigned long long valueBytes(const Token& value);      // Payload of a tuple or string token
+
+	bool snapshotDue(unsigned long long steps) const { return steps >= nextSnapshot; }
+	void beginSnapshot();
+	void addLive(const Token& value);                              // A value the machine still holds
+	void endSnapshot(unsigned long long steps);
+
+	void writeTable(std::ostream& out) const;                      // Sorted by live bytes at peak
+
+private:
+	struct Site {
+		Site() : allocations(0), totalBytes(0), releasedBytes(0), liveBytes(0), peakBytes(0) {}
+		unsigned long long allocations;
+		unsigned long long totalBytes;  // Cumulative
+		unsigned long long releasedBytes;  // Cumulative, environments only
+		unsigned long long liveBytes;   // At the latest snapshot, the one at exit once evaluation is done
+		unsigned long long peakBytes;   // At the snapshot with the most live bytes overall
+	};
+
+	struct DeltaLabel {
+		DeltaLabel() : line(0), seen(false) {}
+		std::string name;
+		std::string param;
+		int line;
+		bool seen;
+	};
+
+	std::vector<Site> sites;            // Indexed by delta number * KIND_COUNT + kind
+	std::vector<DeltaLabel> labels;     // Indexed by delta number
+	std::vector<int> frames;            // Running deltas, main at the bottom
+	unsigned long long nextSnapshot;
+	unsigned long long walked;          // Values visited by the current snapshot
+	unsigned long long liveTotal;
+	unsigned long long peakTotal;
+	unsigned long long peakSteps;
+	unsigned long long snapshots;
+
+	Site& site(int deltaNum, Kind kind);
+	std::string label(int deltaNum) const;
+};
+
+#endif /* HEAPPROFILER_H_ */
@@ -0,0 +1,186 @@
+/**
+ * Lambda Profiler Implementation
+ *
+ * Keeps a shadow call stack driven by closure applications and environment
+ * pops, and accumulates self/inclusive steps and wall time per delta and per
+ * calling context.
+ */
+
+#include "LambdaProfiler.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+LambdaProfiler::LambdaProfiler() {
+	deltas[0].name = "main";
+	contexts.push_back(ContextNode(0, -1));
+	pushFrame(0, 0, 0);
+}
+
+/**
+ * Closure application - opens a frame for deltaNum under the current context
+ */
+void LambdaProfiler::enter(int deltaNum, const string& param, int line, unsigned long long steps) {
+	DeltaProfile& delta = deltas[deltaNum];
+	if(delta.calls == 0) {
+		delta.param = param;
+		delta.line = line;
+	}
+
+	int parentContext = frames.back().contextNode;
+	int context = parentContext;
+	if(contexts[parentContext].deltaNum != deltaNum) {
+		map<int, int>::iterator it = contexts[parentContext].children.find(deltaNum);
+		if(it != contexts[parentContext].children.end()) {
+			context = it->second;
+		} else {
+			context = contexts.size();
+			contexts.push_back(ContextNode(deltaNum, parentContext));
+			contexts[parentContext].children[deltaNum] = context;
+		}
+	}
+	pushFrame(deltaNum, context, steps);
+}
+
+/**
+ * Environment pop - closes the innermost frame and charges it to its delta
+ * The main frame is only closed by finish()
+ */
+void LambdaProfiler::exit(unsigned long long steps) {
+	if(frames.size() <= 1)
+		return;
+	Frame frame = frames.back();
+	frames.pop_back();
+
+	unsigned long long inclusiveSteps = steps - frame.startSteps;
+	double inclusiveSeconds = chrono::duration<double>(Clock::now() - frame.startTime).count();
+
+	DeltaProfile& delta = deltas[frame.deltaNum];
+	delta.selfSteps += inclusiveSteps - frame.childSteps;
+	delta.selfSeconds += inclusiveSeconds - frame.childSeconds;
+	delta.activeFrames--;
+	if(delta.activeFrames == 0) {
+		delta.inclusiveSteps += inclusiveSteps;
+		delta.inclusiveSeconds += inclusiveSeconds;
+	}
+	contexts[frame.contextNode].selfSteps += inclusiveSteps - frame.childSteps;
+
+	frames.back().childSteps += inclusiveSteps;
+	frames.back().childSeconds += inclusiveSeconds;
+}
+
+/**
+ * End of evaluation - closes any frames left open, then the main frame
+ */
+void LambdaProfiler::finish(unsigned long long steps) {
+	while(frames.size() > 1)
+		exit(steps);
+	if(frames.empty())
+		return;
+
+	Frame frame = frames.back();
+	frames.pop_back();
+	DeltaProfile& main = deltas[0];
+	main.inclusiveSteps = steps;
+	main.inclusiveSeconds = chrono::duration<double>(Clock::now() - frame.startTime).count();
+	main.selfSteps = steps - frame.childSteps;
+	main.selfSeconds = main.inclusiveSeconds - frame.childSeconds;
+	contexts[0].selfSteps = main.selfSteps;
+}
+
+/**
+ * Records the first identifier a closure of deltaNum was bound to
+ */
+void LambdaProfiler::nameDelta(int deltaNum, const string& name) {
+	DeltaProfile& delta = deltas[deltaNum];
+	if(delta.name.empty())
+		delta.name = name;
+}
+
+void LambdaProfiler::pushFrame(int deltaNum, int contextNode, unsigned long long steps) {
+	Frame frame;
+	frame.deltaNum = deltaNum;
+	frame.contextNode = contextNode;
+	frame.startSteps = steps;
+	frame.childSteps = 0;
+	frame.startTime = Clock::now();
+	frame.childSeconds = 0;
+	frames.push_back(frame);
+
+	DeltaProfile& delta = deltas[deltaNum];
+	delta.calls++;
+	delta.activeFrames++;
+}
+
+/**
+ * Display name - bound identifier and source line of the lambda; anonymous
+ * lambdas (let and where bodies among them) show their bound variable instead
+ */
+string LambdaProfiler::label(int deltaNum) const {
+	map<int, DeltaProfile>::const_iterator it = deltas.find(deltaNum);
+	ostringstream oss;
+	if(it == deltas.end())
+		oss << "lambda#" << deltaNum;
+	else if(!it->second.name.empty())
+		oss << it->second.name;
+	else
+		oss << "lambda(" << it->second.param << ")";
+	if(it != deltas.end() && it->second.line > 0)
+		oss << ':' << it->second.line;
+	return oss.str();
+}
+
+/**
+ * Flat profile - one row per delta that was entered, heaviest self cost first
+ */
+void LambdaProfiler::writeTable(ostream& out) const {
+	unsigned long long totalSteps = 0;
+	vector<int> rows;
+	for(map<int, DeltaProfile>::const_iterator it = deltas.begin(); it != deltas.end(); ++it) {
+		if(it->second.calls == 0)
+			continue;
+		totalSteps += it->second.selfSteps;
+		rows.push_back(it->first);
+	}
+	sort(rows.begin(), rows.end(), [this](int a, int b) {
+		unsigned long long selfA = deltas.find(a)->second.selfSteps;
+		unsigned long long selfB = deltas.find(b)->second.selfSteps;
+		return selfA != selfB ? selfA > selfB : a < b;
+	});
+
+	out << "Lambda profile" << endl;
+	out << right << setw(8) << "self %" << setw(14) << "self steps" << setw(14) << "incl steps"
+		<< setw(10) << "calls" << setw(12) << "self ms" << setw(12) << "incl ms" << "  function" << endl;
+	for(unsigned int i = 0; i < rows.size(); i++) {
+		const DeltaProfile& delta = deltas.find(rows[i])->second;
+		double percent = totalSteps == 0 ? 0 : 100.0 * delta.selfSteps / totalSteps;
+		out << fixed << setprecision(2) << setw(8) << percent
+			<< setw(14) << delta.selfSteps << setw(14) << delta.inclusiveSteps
+			<< setw(10) << delta.calls
+			<< setprecision(3) << setw(12) << delta.selfSeconds * 1e3
+			<< setw(12) << delta.inclusiveSeconds * 1e3
+			<< "  " << label(rows[i]) << endl;
+	}
+}
+
+/**
+ * Folded stacks - one line per calling context with its self steps,
+ * the input format of flamegraph.pl and compatible viewers
+ */
+void LambdaProfiler::writeFolded(ostream& out) const {
+	for(unsigned int i = 0; i < contexts.size(); i++) {
+		if(contexts[i].selfSteps == 0)
+			continue;
+		vector<int> path;
+		for(int node = i; node >= 0; node = contexts[node].parent)
+			path.push_back(contexts[node].deltaNum);
+		for(int j = path.size() - 1; j >= 0; j--) {
+			out << label(path[j]);
+			if(j > 0)
+				out << ';';
+		}
+		out << ' ' << contexts[i].selfSteps << '\n';
+	}
+}
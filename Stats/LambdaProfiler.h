@@ -0,0 +1,77 @@
+/**
+ * Lambda Profiler Header
+ *
+ * Attributes machine steps and wall time to the delta (lambda body) that was
+ * running when they were spent. The CSE machine reports every closure
+ * application (gamma) and the matching environment pop (env), and the
+ * profiler keeps a shadow call stack from those events. Totals are kept per
+ * delta - calls, self and inclusive steps and time - and per calling
+ * context, which is what the folded-stack output for flamegraph tools is
+ * built from. Direct self-recursion is folded into one context so recursion
+ * depth does not blow up the context tree.
+ */
+
+#ifndef LAMBDAPROFILER_H_
+#define LAMBDAPROFILER_H_
+
+#include <chrono>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class LambdaProfiler {
+public:
+	LambdaProfiler();
+
+	void enter(int deltaNum, const std::string& param, int line, unsigned long long steps); // A closure of deltaNum was applied
+	void exit(unsigned long long steps);                           // Its environment was popped
+	void finish(unsigned long long steps);                         // Closes every open frame, main included
+	void nameDelta(int deltaNum, const std::string& name);         // First identifier a closure was bound to
+
+	void writeTable(std::ostream& out) const;                      // Sorted by self steps
+	void writeFolded(std::ostream& out) const;                     // "main;f;g <self steps>" lines
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct DeltaProfile {
+		DeltaProfile() : line(0), calls(0), selfSteps(0), inclusiveSteps(0),
+				selfSeconds(0), inclusiveSeconds(0), activeFrames(0) {}
+		std::string name;
+		std::string param;              // Bound variable(s), used when the lambda was never named
+		int line;
+		unsigned long long calls;
+		unsigned long long selfSteps;
+		unsigned long long inclusiveSteps;
+		double selfSeconds;
+		double inclusiveSeconds;
+		int activeFrames;               // Open frames of this delta; inclusive totals count the outermost only
+	};
+
+	struct ContextNode {
+		ContextNode(int deltaNum, int parent) : deltaNum(deltaNum), parent(parent), selfSteps(0) {}
+		int deltaNum;
+		int parent;
+		unsigned long long selfSteps;
+		std::map<int, int> children;    // Delta number to context node index
+	};
+
+	struct Frame {
+		int deltaNum;
+		int contextNode;
+		unsigned long long startSteps;
+		unsigned long long childSteps;
+		Clock::time_point startTime;
+		double childSeconds;
+	};
+
+	std::map<int, DeltaProfile> deltas;
+	std::vector<ContextNode> contexts;
+	std::vector<Frame> frames;
+
+	void pushFrame(int deltaNum, int contextNode, unsigned long long steps);
+	std::string label(int deltaNum) const;
+};
+
+#endif /* LAMBDAPROFILER_H_ */
@@ -0,0 +1,233 @@
+/**
+ * Run Statistics Implementation
+ *
+ * Collects per-phase wall times and pipeline counters for one run of the
+ * interpreter and renders them as an aligned text table or a JSON object.
+ */
+
+#include "RunStats.h"
+#include <iomanip>
+#include <sys/resource.h>
+
+using namespace std;
+
+// Labels for the text report and keys for the JSON report, by phase
+static const char* phaseLabels[RunStats::PHASE_COUNT] = {
+	"file load", "lex", "parse", "standardize", "control structures", "evaluate"
+};
+static const char* phaseKeys[RunStats::PHASE_COUNT] = {
+	"file_load", "lex", "parse", "standardize", "control_structures", "evaluate"
+};
+
+RunStats::RunStats() {
+	for(int phase = 0; phase < PHASE_COUNT; phase++) {
+		phaseSeconds[phase] = 0;
+		phaseAllocations[phase] = 0;
+	}
+	tokenCount = 0;
+	astNodeCount = 0;
+	stNodeCount = 0;
+	deltaCount = 0;
+	machineSteps = 0;
+	gammaApplications = 0;
+	knownCalls = 0;
+	environmentsCreated = 0;
+	environmentsReclaimed = 0;
+	peakControlDepth = 0;
+	peakExecutionDepth = 0;
+	peakRssKb = 0;
+	hardwareCounters = NULL;
+	tracer = NULL;
+}
+
+/**
+ * Reads the peak resident set size of the process (kilobytes on Linux)
+ */
+void RunStats::capturePeakRss() {
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) == 0)
+		peakRssKb = usage.ru_maxrss;
+}
+
+/**
+ * Charges the allocations of one machine step to the kind of token it processed
+ */
+void RunStats::countStepAllocations(const string& kind, unsigned long long allocations) {
+	StepAllocations& entry = stepAllocations[kind];
+	entry.steps++;
+	entry.allocations += allocations;
+}
+
+/**
+ * Human-readable report - one phase or counter per line
+ */
+void RunStats::writeText(ostream& out) const {
+	bool allocations = ALLOCATION_COUNTING_ENABLED;
+	double total = 0;
+	out << "Run statistics" << endl;
+	out << fixed << setprecision(3);
+	out << "  phase                         ms" << (allocations ? "        allocs" : "") << endl;
+	for(int phase = 0; phase < PHASE_COUNT; phase++) {
+		out << "  " << left << setw(18) << phaseLabels[phase] << right << setw(16) << phaseSeconds[phase] * 1e3;
+		if(allocations)
+			out << setw(14) << phaseAllocations[phase];
+		out << endl;
+		total += phaseSeconds[phase];
+	}
+	out << "  total               " << setw(14) << total * 1e3 << endl;
+	out << "  counter" << endl;
+	out << "  tokens              " << setw(14) << tokenCount << endl;
+	out << "  ast nodes           " << setw(14) << astNodeCount << endl;
+	out << "  st nodes            " << setw(14) << stNodeCount << endl;
+	out << "  deltas              " << setw(14) << deltaCount << endl;
+	out << "  machine steps       " << setw(14) << machineSteps << endl;
+	out << "  gamma applications  " << setw(14) << gammaApplications << endl;
+	out << "  known calls         " << setw(14) << knownCalls << endl;
+	out << "  environments        " << setw(14) << environmentsCreated << endl;
+	out << "  environments freed  " << setw(14) << environmentsReclaimed << endl;
+	out << "  peak control depth  " << setw(14) << peakControlDepth << endl;
+	out << "  peak stack depth    " << setw(14) << peakExecutionDepth << endl;
+	out << "  peak rss kb         " << setw(14) << peakRssKb << endl;
+	if(hardwareCounters)
+		writeHardwareText(out);
+	if(!allocations)
+		return;
+	out << "  allocs per step     " << setw(14) << setprecision(3)
+		<< (machineSteps == 0 ? 0.0 : (double)phaseAllocations[EVALUATE] / machineSteps) << endl;
+	out << "  step kind                  steps        allocs     per step" << endl;
+	for(map<string, StepAllocations>::const_iterator it = stepAllocations.begin(); it != stepAllocations.end(); ++it) {
+		out << "  " << left << setw(16) << it->first << right << setw(14) << it->second.steps
+			<< setw(14) << it->second.allocations
+			<< setw(13) << (double)it->second.allocations / it->second.steps << endl;
+	}
+}
+
+/**
+ * Hardware counter table - one row per phase, then IPC and per-step rates
+ * of the evaluation loop; unavailable events print as n/a
+ */
+void RunStats::writeHardwareText(ostream& out) const {
+	const HardwareCounters& counters = *hardwareCounters;
+	out << "  hardware counters" << endl;
+	if(!counters.anyAvailable()) {
+		out << "  unavailable: " << counters.error() << endl;
+		return;
+	}
+	out << "  " << left << setw(18) << "phase" << right;
+	for(int event = 0; event < HardwareCounters::EVENT_COUNT; event++)
+		out << setw(15) << HardwareCounters::eventName((HardwareCounters::Event)event);
+	out << endl;
+	for(int phase = 0; phase < PHASE_COUNT; phase++) {
+		out << "  " << left << setw(18) << phaseLabels[phase] << right;
+		for(int event = 0; event < HardwareCounters::EVENT_COUNT; event++) {
+			if(counters.available((HardwareCounters::Event)event))
+				out << setw(15) << phaseHardware[phase].values[event];
+			else
+				out << setw(15) << "n/a";
+		}
+		out << endl;
+	}
+
+	const unsigned long long* evaluation = phaseHardware[EVALUATE].values;
+	if(counters.available(HardwareCounters::CYCLES) && counters.available(HardwareCounters::INSTRUCTIONS)
+			&& evaluation[HardwareCounters::CYCLES] != 0) {
+		out << "  evaluation ipc      " << setw(14)
+			<< (double)evaluation[HardwareCounters::INSTRUCTIONS] / evaluation[HardwareCounters::CYCLES] << endl;
+	}
+	if(machineSteps != 0) {
+		out << "  per machine step" << endl;
+		for(int event = 0; event < HardwareCounters::EVENT_COUNT; event++) {
+			if(!counters.available((HardwareCounters::Event)event))
+				continue;
+			out << "    " << left << setw(16) << HardwareCounters::eventName((HardwareCounters::Event)event) << right
+				<< setw(14) << (double)evaluation[event] / machineSteps << endl;
+		}
+	}
+	if(!counters.error().empty())
+		out << "  unavailable: " << counters.error() << endl;
+}
+
+/**
+ * Machine-readable report - a single JSON object with phases and counters
+ */
+void RunStats::writeJson(ostream& out) const {
+	out << fixed << setprecision(6);
+	out << "{\"phases_ms\": {";
+	for(int phase = 0; phase < PHASE_COUNT; phase++)
+		out << (phase ? ", " : "") << "\"" << phaseKeys[phase] << "\": " << phaseSeconds[phase] * 1e3;
+	out << "}, \"counters\": {"
+		<< "\"tokens\": " << tokenCount
+		<< ", \"ast_nodes\": " << astNodeCount
+		<< ", \"st_nodes\": " << stNodeCount
+		<< ", \"deltas\": " << deltaCount
+		<< ", \"machine_steps\": " << machineSteps
+		<< ", \"gamma_applications\": " << gammaApplications
+		<< ", \"known_calls\": " << knownCalls
+		<< ", \"environments\": " << environmentsCreated
+		<< ", \"environments_reclaimed\": " << environmentsReclaimed
+		<< ", \"peak_control_depth\": " << peakControlDepth
+		<< ", \"peak_stack_depth\": " << peakExecutionDepth
+		<< ", \"peak_rss_kb\": " << peakRssKb
+		<< "}";
+	if(hardwareCounters)
+		writeHardwareJson(out);
+	if(ALLOCATION_COUNTING_ENABLED) {
+		out << ", \"allocations\": {";
+		for(int phase = 0; phase < PHASE_COUNT; phase++)
+			out << (phase ? ", " : "") << "\"" << phaseKeys[phase] << "\": " << phaseAllocations[phase];
+		out << "}, \"step_allocations\": {";
+		for(map<string, StepAllocations>::const_iterator it = stepAllocations.begin(); it != stepAllocations.end(); ++it) {
+			out << (it == stepAllocations.begin() ? "" : ", ") << "\"" << it->first << "\": {\"steps\": "
+				<< it->second.steps << ", \"allocations\": " << it->second.allocations << "}";
+		}
+		out << "}";
+	}
+	out << "}" << endl;
+}
+
+/**
+ * "hardware": per-phase event counts, with null for unavailable events
+ */
+void RunStats::writeHardwareJson(ostream& out) const {
+	const HardwareCounters& counters = *hardwareCounters;
+	out << ", \"hardware\": {\"available\": " << (counters.anyAvailable() ? "true" : "false")
+		<< ", \"error\": \"" << counters.error() << "\"";
+	for(int phase = 0; phase < PHASE_COUNT; phase++) {
+		out << ", \"" << phaseKeys[phase] << "\": {";
+		for(int event = 0; event < HardwareCounters::EVENT_COUNT; event++) {
+			out << (event ? ", " : "") << "\"" << HardwareCounters::eventName((HardwareCounters::Event)event) << "\": ";
+			if(counters.available((HardwareCounters::Event)event))
+				out << phaseHardware[phase].values[event];
+			else
+				out << "null";
+		}
+		out << "}";
+	}
+	out << "}";
+}
+
+PhaseTimer::PhaseTimer(RunStats* stats, RunStats::Phase phase) {
+	this->stats = stats;
+	this->phase = phase;
+	this->startAllocations = ALLOCATION_COUNT();
+	if(!stats)
+		return;
+	if(stats->hardwareCounters)
+		startHardware = stats->hardwareCounters->read();
+	start = chrono::steady_clock::now();
+}
+
+PhaseTimer::~PhaseTimer() {
+	if(!stats)
+		return;
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	stats->phaseSeconds[phase] += chrono::duration<double>(end - start).count();
+	stats->phaseAllocations[phase] += ALLOCATION_COUNT() - startAllocations;
+	if(stats->hardwareCounters) {
+		HardwareCounters::Snapshot endHardware = stats->hardwareCounters->read();
+		for(int event = 0; event < HardwareCounters::EVENT_COUNT; event++)
+			stats->phaseHardware[phase].values[event] += endHardware.values[event] - startHardware.values[event];
+	}
+	if(stats->tracer)
+		stats->tracer->phase(phaseLabels[phase], start, end);
+}
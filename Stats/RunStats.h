@@ -0,0 +1,102 @@
+/**
+ * Run Statistics Header
+ *
+ * RunStats collects per-phase wall times and pipeline counters for one run of
+ * the interpreter and renders them as text or JSON. Components receive a
+ * pointer that is NULL when statistics are off, so the disabled cost is a
+ * single predictable branch; building with -DRPAL_NO_STATS removes the
+ * counting code altogether. Diagnostic builds with -DRPAL_COUNT_ALLOCATIONS
+ * also count heap allocations per phase and per kind of machine step, and
+ * --hwcounters adds CPU performance counters per phase.
+ */
+
+#ifndef RUNSTATS_H_
+#define RUNSTATS_H_
+
+#include <chrono>
+#include <map>
+#include <ostream>
+#include <string>
+#include "AllocationCounter.h"
+#include "HardwareCounters.h"
+#include "ExecutionTracer.h"
+
+#ifdef RPAL_NO_STATS
+#define STATS_ADD(stats, field, amount) ((void)0)
+#define STATS_MAX(stats, field, value) ((void)0)
+#else
+#define STATS_ADD(stats, field, amount) do { if(stats) (stats)->field += (amount); } while(0)
+#define STATS_MAX(stats, field, value) do { if(stats && (stats)->field < (value)) (stats)->field = (value); } while(0)
+#endif
+
+class RunStats {
+public:
+	// Pipeline phases, in the order they run
+	enum Phase { FILE_LOAD, LEX, PARSE, STANDARDIZE, CONTROL_STRUCTURES, EVALUATE, PHASE_COUNT };
+
+	RunStats();
+
+	// Per-phase wall time in seconds, and heap allocations (diagnostic builds only)
+	double phaseSeconds[PHASE_COUNT];
+	unsigned long long phaseAllocations[PHASE_COUNT];
+
+	// Front-end counters
+	unsigned long long tokenCount;
+	unsigned long long astNodeCount;
+	unsigned long long stNodeCount;
+	unsigned long long deltaCount;
+
+	// Machine counters
+	unsigned long long machineSteps;
+	unsigned long long gammaApplications;
+	unsigned long long knownCalls;
+	unsigned long long environmentsCreated;
+	unsigned long long environmentsReclaimed;
+	unsigned long long peakControlDepth;
+	unsigned long long peakExecutionDepth;
+
+	// Process counters
+	long peakRssKb;
+
+	// Heap allocations per kind of control token, diagnostic builds only
+	struct StepAllocations {
+		StepAllocations() : steps(0), allocations(0) {}
+		unsigned long long steps;
+		unsigned long long allocations;
+	};
+	std::map<std::string, StepAllocations> stepAllocations;
+
+	// Hardware counter deltas per phase for --hwcounters; NULL when off
+	HardwareCounters* hardwareCounters;
+	HardwareCounters::Snapshot phaseHardware[PHASE_COUNT];
+
+	// Timeline that also receives each phase as a span for --trace; NULL when off
+	ExecutionTracer* tracer;
+
+	void capturePeakRss();                  // Reads the high-water resident set size
+	void countStepAllocations(const std::string& kind, unsigned long long allocations);
+	void writeText(std::ostream& out) const;
+	void writeJson(std::ostream& out) const;
+private:
+	void writeHardwareText(std::ostream& out) const;
+	void writeHardwareJson(std::ostream& out) const;
+};
+
+/**
+ * Scoped phase timer - adds the elapsed wall time, and when enabled the
+ * allocations made and hardware counter deltas, to a phase of RunStats on
+ * destruction, and hands the phase to the tracer. Does nothing when constructed with a NULL stats pointer.
+ */
+class PhaseTimer {
+public:
+	PhaseTimer(RunStats* stats, RunStats::Phase phase);
+	~PhaseTimer();
+private:
+	RunStats* stats;
+	RunStats::Phase phase;
+	std::chrono::steady_clock::time_point start;
+	unsigned long long startAllocations;
+	HardwareCounters::Snapshot startHardware;
+};
+
+#endif /* RUNSTATS_H_ */
@@ -26,6 +26,8 @@ void Token::construct() {
  */
 Token::Token() {
     isTuple = false;
+    line = 0;
+    allocDelta = -1;
     construct();
 }
 
@@ -40,6 +42,8 @@ Token::Token(std::string type, std::string lambdaParam, int lambdaNum) {
     this->lambdaParam = lambdaParam;
     this->lambdaNum = lambdaNum;
     isTuple = false;
+    line = 0;
+    allocDelta = -1;
     construct();
 }
 
@@ -52,6 +56,8 @@ Token::Token(std::string type, int envNum) {
     this->type = type;
     this->envNum = envNum;
     isTuple = false;
+    line = 0;
+    allocDelta = -1;
     construct();
 }
 
@@ -64,6 +70,8 @@ Token::Token(std::string value, std::string type) {
     this->value = value;
     this->type = type;
     isTuple = false;
+    line = 0;
+    allocDelta = -1;
     construct();
 }
 
@@ -78,6 +86,8 @@ Token::Token(std::string type, int betaIfDeltaNum, int betaElseDeltaNum) {
     this->betaIfDeltaNum = betaIfDeltaNum;
     this->betaElseDeltaNum = betaElseDeltaNum;
     isTuple = false;
+    line = 0;
+    allocDelta = -1;
     construct();
 }
 
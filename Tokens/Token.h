@@ -7,12 +7,16 @@
  * and conditional constructs, providing a flexible structure for language processing.
  */
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
 #ifndef TOKEN_H_
 #define TOKEN_H_
 
+class PersistentMap;
+
 class Token {
 public:
     /**
@@ -50,6 +54,16 @@ public:
      */
     Token(std::string type, int betaIfDeltaNum, int betaElseDeltaNum);
     
+    /**
+     * Copy and move - declared explicitly because the virtual destructor
+     * would otherwise suppress the implicit moves, turning every move of a
+     * token on the machine stacks into a deep copy
+     */
+    Token(const Token&) = default;
+    Token(Token&&) = default;
+    Token& operator=(const Token&) = default;
+    Token& operator=(Token&&) = default;
+
     /**
      * Destructor - cleans up token resources
      */
@@ -64,14 +78,19 @@ public:
     std::string value;              // Token value content
     std::string type;               // Token type identifier
     int lambdaNum;                  // Lambda identifier number
+    int fusedIndex;                 // Superinstruction entry in the machine's table of fused sequences
     std::string lambdaParam;        // Lambda parameter name
     int envNum;                     // Environment identifier
     int betaIfDeltaNum;            // Beta if branch number
     int betaElseDeltaNum;          // Beta else branch number
     int tauCount;                   // Tau count for tuples
     bool isTuple;                   // Tuple flag indicator
+    int allocDelta;                 // Delta that created this tuple or string (heap profiler), -1 when untracked
     std::vector<Token> tuple;       // Tuple container
+    std::shared_ptr<const std::vector<int64_t> > packed;  // All-integer tuple as contiguous machine words, shared by copies; NULL until packed
+    std::shared_ptr<const PersistentMap> map;         // Contents of a map value, shared by copies
     int lambdaEnv;                  // Lambda environment reference
+    int line;                       // Source line, 0 when synthesized
 
 };
 